@@ -0,0 +1,89 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+/* Identifier interning. Each distinct name gets a dense id (0, 1, 2...
+   in first-seen order), so later phases compare names as integers and
+   index their tables by id. Names are stored NUL-terminated in a single
+   pool; lookup is open addressing on an FNV-1a hash. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char *pool;             /* names back to back, each NUL-terminated */
+    size_t pool_len, pool_cap;
+    size_t *off;            /* id -> offset of its name in pool */
+    uint32_t *hash;         /* id -> hash of its name */
+    uint32_t count, cap;    /* ids handed out / allocated */
+    uint32_t *slot;         /* id + 1 per slot, 0 when empty */
+    uint32_t mask;          /* slot count - 1 */
+} InternTable;
+
+static void *intern_alloc(void *p, size_t n) {
+    p = realloc(p, n);
+    if (!p) { fprintf(stderr, "Out of memory\n"); exit(1); }
+    return p;
+}
+
+static uint32_t intern_hash(const char *s, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+/* Double the slot array and re-seat every id from its stored hash */
+static void intern_rehash(InternTable *t) {
+    uint32_t n = t->mask ? (t->mask + 1) * 2 : 1024;
+    free(t->slot);
+    t->slot = calloc(n, sizeof *t->slot);
+    if (!t->slot) { fprintf(stderr, "Out of memory\n"); exit(1); }
+    t->mask = n - 1;
+    for (uint32_t id = 0; id < t->count; id++) {
+        uint32_t i = t->hash[id] & t->mask;
+        while (t->slot[i]) i = (i + 1) & t->mask;
+        t->slot[i] = id + 1;
+    }
+}
+
+/* Id of the name s[0, n), adding it on first sight */
+static inline uint32_t intern(InternTable *t, const char *s, size_t n) {
+    if (2 * (t->count + 1) > t->mask) intern_rehash(t);
+    uint32_t h = intern_hash(s, n), i = h & t->mask;
+    for (uint32_t e; (e = t->slot[i]) != 0; i = (i + 1) & t->mask) {
+        const char *name = t->pool + t->off[e - 1];
+        if (t->hash[e - 1] == h && strncmp(name, s, n) == 0 && name[n] == 0) return e - 1;
+    }
+
+    if (t->count == t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 1024;
+        t->off = intern_alloc(t->off, t->cap * sizeof *t->off);
+        t->hash = intern_alloc(t->hash, t->cap * sizeof *t->hash);
+    }
+    if (t->pool_len + n + 1 > t->pool_cap) {
+        while (t->pool_len + n + 1 > t->pool_cap) t->pool_cap = t->pool_cap ? t->pool_cap * 2 : 1 << 16;
+        t->pool = intern_alloc(t->pool, t->pool_cap);
+    }
+    memcpy(t->pool + t->pool_len, s, n);
+    t->pool[t->pool_len + n] = 0;
+    t->off[t->count] = t->pool_len;
+    t->hash[t->count] = h;
+    t->pool_len += n + 1;
+    t->slot[i] = t->count + 1;
+    return t->count++;
+}
+
+static inline const char *intern_name(const InternTable *t, uint32_t id) {
+    return t->pool + t->off[id];
+}
+
+static inline void intern_free(InternTable *t) {
+    free(t->pool);
+    free(t->off);
+    free(t->hash);
+    free(t->slot);
+    memset(t, 0, sizeof *t);
+}
+
+#endif /* INTERN_H */
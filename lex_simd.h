@@ -0,0 +1,447 @@
+#ifndef LEX_SIMD_H
+#define LEX_SIMD_H
+
+/* Character-class kernels for the lexer hot loops.
+   Each kernel scans [p, e) and returns the first byte that ends the run
+   (or e). ws and comment_end also add the newlines they pass to *lines.
+   classify64 fills per-byte class bitmasks for one 64-byte block (bit i
+   is byte i) for the structural-index pass. utf8 returns the first byte
+   of an invalid UTF-8 sequence, or of one cut off by e (or e).
+   lex_simd_init() picks AVX2, SSE2 or the scalar versions at runtime;
+   build with -DLEX_NO_SIMD to force the scalar ones. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(LEX_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define LEX_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+typedef struct {
+    uint64_t blank;  /* ' ' and \t..\r */
+    uint64_t nl;
+    uint64_t ident;  /* [A-Za-z0-9_] */
+    uint64_t digit;
+} LexBlockMasks;
+
+typedef struct {
+    const unsigned char *(*ws)(const unsigned char *p, const unsigned char *e, int *lines);
+    const unsigned char *(*ident)(const unsigned char *p, const unsigned char *e);
+    const unsigned char *(*digits)(const unsigned char *p, const unsigned char *e);
+    /* returns the '*' of the first "*" "/" pair, or NULL */
+    const unsigned char *(*comment_end)(const unsigned char *p, const unsigned char *e, int *lines);
+    void (*classify64)(const unsigned char *p, LexBlockMasks *m);
+    const unsigned char *(*utf8)(const unsigned char *p, const unsigned char *e);
+    const char *name;
+} LexKernels;
+
+/* ---------- Bit helpers ---------- */
+
+#ifdef __GNUC__
+#define lex_ctz64(x)      __builtin_ctzll(x)
+#define lex_popcount64(x) __builtin_popcountll(x)
+#else
+static int lex_ctz64(uint64_t x) { int n = 0; while (!(x & 1)) { x >>= 1; n++; } return n; }
+static int lex_popcount64(uint64_t x) { int n = 0; while (x) { x &= x - 1; n++; } return n; }
+#endif
+
+/* Value of the eight ASCII digits at p. SWAR on a little-endian load:
+   combine neighbouring digits into pairs, then pairs into the result. */
+static uint32_t lex_parse8(const unsigned char *p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t v;
+    memcpy(&v, p, 8);
+    v -= 0x3030303030303030ULL;
+    v = v * 10 + (v >> 8);
+    v = ((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)) +
+         ((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))) >> 32;
+    return (uint32_t)v;
+#else
+    uint32_t v = 0;
+    for (int i = 0; i < 8; i++) v = v * 10 + (uint32_t)(p[i] - '0');
+    return v;
+#endif
+}
+
+/* ---------- Scalar ---------- */
+
+static int lex_is_blank(unsigned c) { return c == ' ' || (c - '\t') <= 4u; }
+static int lex_is_ident(unsigned c) {
+    return ((c | 0x20) - 'a') < 26u || (c - '0') < 10u || c == '_';
+}
+
+static const unsigned char *ws_scalar(const unsigned char *p, const unsigned char *e, int *lines) {
+    for (; p < e && lex_is_blank(*p); p++)
+        if (*p == '\n') (*lines)++;
+    return p;
+}
+
+static const unsigned char *ident_scalar(const unsigned char *p, const unsigned char *e) {
+    while (p < e && lex_is_ident(*p)) p++;
+    return p;
+}
+
+static const unsigned char *digits_scalar(const unsigned char *p, const unsigned char *e) {
+    while (p < e && (unsigned)(*p - '0') < 10u) p++;
+    return p;
+}
+
+static const unsigned char *comment_end_scalar(const unsigned char *p, const unsigned char *e, int *lines) {
+    for (; p + 1 < e; p++) {
+        if (*p == '*' && p[1] == '/') return p;
+        if (*p == '\n') (*lines)++;
+    }
+    if (p < e && *p == '\n') (*lines)++;
+    return NULL;
+}
+
+/* Length of the UTF-8 sequence at p (p < e). If it is invalid or cut off
+   by e: minus the length of its longest valid prefix, at least 1 (the
+   bytes a decoder would replace with one U+FFFD). */
+static int lex_utf8_len(const unsigned char *p, const unsigned char *e) {
+    unsigned c = p[0], lo = 0x80, hi = 0xBF;
+    int n;
+    if (c < 0x80) return 1;
+    if (c < 0xC2 || c > 0xF4) return -1;
+    if (c < 0xE0) n = 2;
+    else if (c < 0xF0) { n = 3; if (c == 0xE0) lo = 0xA0; else if (c == 0xED) hi = 0x9F; }
+    else { n = 4; if (c == 0xF0) lo = 0x90; else if (c == 0xF4) hi = 0x8F; }
+    for (int i = 1; i < n; i++) {
+        if (p + i >= e || p[i] < lo || p[i] > hi) return -i;
+        lo = 0x80; hi = 0xBF;
+    }
+    return n;
+}
+
+static const unsigned char *utf8_scalar(const unsigned char *p, const unsigned char *e) {
+    while (p < e) {
+        uint64_t w;
+        if (e - p >= 8 && (memcpy(&w, p, 8), !(w & 0x8080808080808080ull))) { p += 8; continue; }
+        int n = lex_utf8_len(p, e);
+        if (n < 0) return p;
+        p += n;
+    }
+    return e;
+}
+
+static void classify64_scalar(const unsigned char *p, LexBlockMasks *m) {
+    LexBlockMasks r = { 0, 0, 0, 0 };
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        if (lex_is_blank(p[i])) r.blank |= bit;
+        if (p[i] == '\n') r.nl |= bit;
+        if (lex_is_ident(p[i])) r.ident |= bit;
+        if ((unsigned)(p[i] - '0') < 10u) r.digit |= bit;
+    }
+    *m = r;
+}
+
+#ifdef LEX_SIMD_X86
+
+/* ---------- SSE2 (16 bytes per step) ---------- */
+
+/* lanes where lo <= v <= hi, unsigned */
+#define SSE_RANGE(v, lo, hi) \
+    _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(v, _mm_set1_epi8((char)(lo))), \
+                                _mm_set1_epi8((char)((hi) - (lo)))), \
+                   _mm_sub_epi8(v, _mm_set1_epi8((char)(lo))))
+
+static const unsigned char *ws_sse2(const unsigned char *p, const unsigned char *e, int *lines) {
+    const __m128i sp = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n');
+    for (; e - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, sp), SSE_RANGE(v, '\t', '\r'));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(blank) & 0xFFFFu;
+        unsigned nls = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        if (stop) {
+            unsigned k = (unsigned)__builtin_ctz(stop);
+            *lines += __builtin_popcount(nls & ((1u << k) - 1));
+            return p + k;
+        }
+        *lines += __builtin_popcount(nls);
+    }
+    return ws_scalar(p, e, lines);
+}
+
+static const unsigned char *ident_sse2(const unsigned char *p, const unsigned char *e) {
+    const __m128i fold = _mm_set1_epi8(0x20), us = _mm_set1_epi8('_');
+    for (; e - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i lower = _mm_or_si128(v, fold);
+        __m128i ok = _mm_or_si128(_mm_or_si128(SSE_RANGE(lower, 'a', 'z'), SSE_RANGE(v, '0', '9')),
+                                  _mm_cmpeq_epi8(v, us));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(ok) & 0xFFFFu;
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return ident_scalar(p, e);
+}
+
+static const unsigned char *digits_sse2(const unsigned char *p, const unsigned char *e) {
+    for (; e - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(SSE_RANGE(v, '0', '9')) & 0xFFFFu;
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return digits_scalar(p, e);
+}
+
+/* ASCII runs 16 bytes at a time; other sequences one by one */
+static const unsigned char *utf8_sse2(const unsigned char *p, const unsigned char *e) {
+    while (e - p >= 16) {
+        unsigned hi = (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)p));
+        if (!hi) { p += 16; continue; }
+        p += __builtin_ctz(hi);
+        int n = lex_utf8_len(p, e);
+        if (n < 0) return p;
+        p += n;
+    }
+    return utf8_scalar(p, e);
+}
+
+static const unsigned char *comment_end_sse2(const unsigned char *p, const unsigned char *e, int *lines) {
+    const __m128i star = _mm_set1_epi8('*'), slash = _mm_set1_epi8('/'), nl = _mm_set1_epi8('\n');
+    for (; e - p >= 17; p += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)p);
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(p + 1));
+        unsigned hit = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(v0, star),
+                                                                 _mm_cmpeq_epi8(v1, slash)));
+        unsigned nls = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v0, nl));
+        if (hit) {
+            unsigned k = (unsigned)__builtin_ctz(hit);
+            *lines += __builtin_popcount(nls & ((1u << k) - 1));
+            return p + k;
+        }
+        *lines += __builtin_popcount(nls);
+    }
+    return comment_end_scalar(p, e, lines);
+}
+
+static void classify64_sse2(const unsigned char *p, LexBlockMasks *m) {
+    const __m128i sp = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n');
+    const __m128i fold = _mm_set1_epi8(0x20), us = _mm_set1_epi8('_');
+    LexBlockMasks r = { 0, 0, 0, 0 };
+    for (int i = 0; i < 64; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i digit = SSE_RANGE(v, '0', '9');
+        __m128i ident = _mm_or_si128(_mm_or_si128(SSE_RANGE(_mm_or_si128(v, fold), 'a', 'z'), digit),
+                                     _mm_cmpeq_epi8(v, us));
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, sp), SSE_RANGE(v, '\t', '\r'));
+        r.blank |= (uint64_t)(unsigned)_mm_movemask_epi8(blank) << i;
+        r.nl    |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)) << i;
+        r.ident |= (uint64_t)(unsigned)_mm_movemask_epi8(ident) << i;
+        r.digit |= (uint64_t)(unsigned)_mm_movemask_epi8(digit) << i;
+    }
+    *m = r;
+}
+
+/* ---------- AVX2 (32 bytes per step) ---------- */
+
+#define AVX_RANGE(v, lo, hi) \
+    _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8((char)(lo))), \
+                                      _mm256_set1_epi8((char)((hi) - (lo)))), \
+                      _mm256_sub_epi8(v, _mm256_set1_epi8((char)(lo))))
+
+__attribute__((target("avx2")))
+static const unsigned char *ws_avx2(const unsigned char *p, const unsigned char *e, int *lines) {
+    const __m256i sp = _mm256_set1_epi8(' '), nl = _mm256_set1_epi8('\n');
+    for (; e - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(v, sp), AVX_RANGE(v, '\t', '\r'));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(blank);
+        unsigned nls = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+        if (stop) {
+            unsigned k = (unsigned)__builtin_ctz(stop);
+            *lines += __builtin_popcount(k ? nls & (0xFFFFFFFFu >> (32 - k)) : 0);
+            return p + k;
+        }
+        *lines += __builtin_popcount(nls);
+    }
+    return ws_sse2(p, e, lines);
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *ident_avx2(const unsigned char *p, const unsigned char *e) {
+    const __m256i fold = _mm256_set1_epi8(0x20), us = _mm256_set1_epi8('_');
+    for (; e - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i lower = _mm256_or_si256(v, fold);
+        __m256i ok = _mm256_or_si256(_mm256_or_si256(AVX_RANGE(lower, 'a', 'z'), AVX_RANGE(v, '0', '9')),
+                                     _mm256_cmpeq_epi8(v, us));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(ok);
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return ident_sse2(p, e);
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *digits_avx2(const unsigned char *p, const unsigned char *e) {
+    for (; e - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(AVX_RANGE(v, '0', '9'));
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return digits_sse2(p, e);
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *comment_end_avx2(const unsigned char *p, const unsigned char *e, int *lines) {
+    const __m256i star = _mm256_set1_epi8('*'), slash = _mm256_set1_epi8('/'), nl = _mm256_set1_epi8('\n');
+    for (; e - p >= 33; p += 32) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)p);
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(p + 1));
+        unsigned hit = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(v0, star),
+                                                                       _mm256_cmpeq_epi8(v1, slash)));
+        unsigned nls = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v0, nl));
+        if (hit) {
+            unsigned k = (unsigned)__builtin_ctz(hit);
+            *lines += __builtin_popcount(k ? nls & (0xFFFFFFFFu >> (32 - k)) : 0);
+            return p + k;
+        }
+        *lines += __builtin_popcount(nls);
+    }
+    return comment_end_sse2(p, e, lines);
+}
+
+/* UTF-8 validation by table lookup (Keiser and Lemire, "Validating UTF-8
+   in less than one instruction per byte"). Each byte is checked against
+   its predecessor through three nibble tables whose bits name the error
+   classes, and 3rd/4th bytes of long sequences against the lead two and
+   three bytes back. A block only says whether it (or a sequence cut off
+   at the end of the previous one) has an error; the scalar code then
+   finds the exact byte, restarting at the last sequence start. */
+
+#define U8_TOO_SHORT  0x01
+#define U8_TOO_LONG   0x02
+#define U8_OVERLONG_3 0x04
+#define U8_TOO_LARGE  0x08
+#define U8_SURROGATE  0x10
+#define U8_OVERLONG_2 0x20
+#define U8_TOO_LARGE_1000 0x40
+#define U8_OVERLONG_4 0x40
+#define U8_TWO_CONTS  0x80
+#define U8_CARRY (U8_TOO_SHORT | U8_TOO_LONG | U8_TWO_CONTS)
+
+#define AVX_TABLE16(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, q) \
+    _mm256_setr_epi8((char)(a), (char)(b), (char)(c), (char)(d), (char)(e), (char)(f), (char)(g), (char)(h), \
+                     (char)(i), (char)(j), (char)(k), (char)(l), (char)(m), (char)(n), (char)(o), (char)(q), \
+                     (char)(a), (char)(b), (char)(c), (char)(d), (char)(e), (char)(f), (char)(g), (char)(h), \
+                     (char)(i), (char)(j), (char)(k), (char)(l), (char)(m), (char)(n), (char)(o), (char)(q))
+
+/* the first byte at or after max(start, p - 3) that starts a sequence, else p */
+static const unsigned char *utf8_resync(const unsigned char *start, const unsigned char *p) {
+    const unsigned char *q = p - start > 3 ? p - 3 : start;
+    while (q < p && (*q & 0xC0) == 0x80) q++;
+    return q;
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *utf8_avx2(const unsigned char *p, const unsigned char *e) {
+    const unsigned char *start = p;
+    const __m256i lo4 = _mm256_set1_epi8(0x0F);
+    const __m256i byte_1_high = AVX_TABLE16(
+        U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,
+        U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,
+        U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS,
+        U8_TOO_SHORT | U8_OVERLONG_2,
+        U8_TOO_SHORT,
+        U8_TOO_SHORT | U8_OVERLONG_3 | U8_SURROGATE,
+        U8_TOO_SHORT | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_OVERLONG_4);
+    const __m256i byte_1_low = AVX_TABLE16(
+        U8_CARRY | U8_OVERLONG_3 | U8_OVERLONG_2 | U8_OVERLONG_4,
+        U8_CARRY | U8_OVERLONG_2,
+        U8_CARRY, U8_CARRY,
+        U8_CARRY | U8_TOO_LARGE,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_SURROGATE,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+        U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000);
+    const __m256i byte_2_high = AVX_TABLE16(
+        U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+        U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+        U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE_1000 | U8_OVERLONG_4,
+        U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE,
+        U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE | U8_TOO_LARGE,
+        U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE | U8_TOO_LARGE,
+        U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT);
+    /* non-zero in the last three lanes when a sequence there runs past the block */
+    const __m256i incomplete_max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+
+    __m256i prev = _mm256_setzero_si256(), prev_incomplete = _mm256_setzero_si256();
+    for (; e - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i err;
+        if (!_mm256_movemask_epi8(v)) {
+            err = prev_incomplete;
+        } else {
+            __m256i shifted = _mm256_permute2x128_si256(prev, v, 0x21);
+            __m256i prev1 = _mm256_alignr_epi8(v, shifted, 15);
+            __m256i prev2 = _mm256_alignr_epi8(v, shifted, 14);
+            __m256i prev3 = _mm256_alignr_epi8(v, shifted, 13);
+            __m256i sc = _mm256_and_si256(
+                _mm256_and_si256(_mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), lo4)),
+                                 _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, lo4))),
+                _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(v, 4), lo4)));
+            __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80))),
+                                             _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80))));
+            err = _mm256_xor_si256(_mm256_and_si256(must23, _mm256_set1_epi8((char)0x80)), sc);
+            prev_incomplete = _mm256_subs_epu8(v, incomplete_max);
+        }
+        if (!_mm256_testz_si256(err, err)) return utf8_scalar(utf8_resync(start, p), e);
+        prev = v;
+    }
+    return utf8_sse2(utf8_resync(start, p), e);
+}
+
+__attribute__((target("avx2")))
+static void classify64_avx2(const unsigned char *p, LexBlockMasks *m) {
+    const __m256i sp = _mm256_set1_epi8(' '), nl = _mm256_set1_epi8('\n');
+    const __m256i fold = _mm256_set1_epi8(0x20), us = _mm256_set1_epi8('_');
+    LexBlockMasks r = { 0, 0, 0, 0 };
+    for (int i = 0; i < 64; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i digit = AVX_RANGE(v, '0', '9');
+        __m256i ident = _mm256_or_si256(_mm256_or_si256(AVX_RANGE(_mm256_or_si256(v, fold), 'a', 'z'), digit),
+                                        _mm256_cmpeq_epi8(v, us));
+        __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(v, sp), AVX_RANGE(v, '\t', '\r'));
+        r.blank |= (uint64_t)(unsigned)_mm256_movemask_epi8(blank) << i;
+        r.nl    |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)) << i;
+        r.ident |= (uint64_t)(unsigned)_mm256_movemask_epi8(ident) << i;
+        r.digit |= (uint64_t)(unsigned)_mm256_movemask_epi8(digit) << i;
+    }
+    *m = r;
+}
+
+#endif /* LEX_SIMD_X86 */
+
+static LexKernels lex_simd = {
+    ws_scalar, ident_scalar, digits_scalar, comment_end_scalar, classify64_scalar, utf8_scalar, "scalar"
+};
+
+static void lex_simd_init(void) {
+#ifdef LEX_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        LexKernels k = { ws_avx2, ident_avx2, digits_avx2, comment_end_avx2,
+                         classify64_avx2, utf8_avx2, "avx2" };
+        lex_simd = k;
+    } else {
+        LexKernels k = { ws_sse2, ident_sse2, digits_sse2, comment_end_sse2,
+                         classify64_sse2, utf8_sse2, "sse2" };
+        lex_simd = k;
+    }
+#endif
+}
+
+#endif /* LEX_SIMD_H */
@@ -0,0 +1,898 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+/* Reentrant lexer. All scanning state lives in a lexer_t, so several
+   lexers can run at once on different threads. Tokens are pulled on
+   demand; the lexer refills a small internal ring of tokens in batches.
+
+       lexer_t *lx = lexer_open("source.c");    (NULL: standard input)
+       token_t t;
+       while (lexer_next(lx, &t))
+           ... t.kind, lexer_text(lx, &t), t.len, t.line ...
+       lexer_close(lx);
+
+   Tokens are spans into the source; nothing is copied or truncated. A
+   streamed input keeps the bytes of queued tokens in its window, so
+   lexer_text() is valid until the next lexer_next()/lexer_peek(). So
+   that blanks and comments after them do not pile up there too, a
+   streamed refill hands out the tokens it has queued before reading on.
+   Diagnostics are printed to stderr as "Line N: msg" unless on_error is
+   set; with caret (and a line table) they also show the source line
+   with a caret under the offending byte. Options are plain fields, set before the first lexer_next(). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include <pthread.h>
+
+#include "lex_simd.h"
+#include "lex_tables.h"
+#include "tok_kinds.h"
+#include "intern.h"
+
+#ifndef STREAM_BLOCK
+#define STREAM_BLOCK (1 << 18)
+#endif
+#define LEXER_RING 64          /* token slots; refilled in one batch */
+#define INDEX_WINDOW (1 << 14) /* source bytes indexed per stage-1 pass */
+
+typedef struct {
+    TokKind kind;           /* tok_kind_name[kind] names it, e.g. "IDENTIFIER" */
+    size_t off, len;        /* lexeme span in the source */
+    int quoted;             /* 1 for constants: the span sits inside the quotes */
+    int line;
+    int value;              /* INT_CONST: its value, INT_MAX if out of range;
+                               CHAR_CONST: its byte, escapes decoded */
+    int out_of_range;
+    int id;                 /* IDENTIFIER: interned name id when names is set, else -1 */
+    size_t lit, lit_len;    /* constants, when literals is set: decoded bytes
+                               at literals->data + lit, NUL-terminated */
+} token_t;
+
+/* Whole token in the source, quotes included */
+#define TOKEN_BEGIN(t) ((t)->off - (size_t)(t)->quoted)
+#define TOKEN_END(t)   ((t)->off + (t)->len + (size_t)(t)->quoted)
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} TextBuf;
+
+/* Make room for n more bytes */
+static void buf_reserve(TextBuf *b, size_t n) {
+    if (b->cap - b->len >= n) return;
+    size_t cap = b->cap ? b->cap * 2 : 1 << 16;
+    while (cap - b->len < n) cap *= 2;
+    char *d = realloc(b->data, cap);
+    if (!d) { fprintf(stderr, "Out of memory\n"); exit(1); }
+    b->data = d; b->cap = cap;
+}
+
+static void buf_printf(TextBuf *b, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t)n < b->cap - b->len) { b->len += (size_t)n; return; }
+        buf_reserve(b, (size_t)n + 1);
+    }
+}
+
+/* Line starts, recorded as the lexer passes them (lexer_t.lines) */
+typedef struct {
+    size_t *start;              /* input offset where each line begins */
+    size_t n, cap;
+    int first_line;             /* line number of start[0] */
+    size_t done;                /* input searched for newlines up to here */
+} LineTable;
+
+typedef struct {
+    uint32_t off;   /* offset from the window start */
+    int line;
+} IndexEntry;
+
+typedef struct {
+    /* Source: a whole buffer (a mapped file or caller memory), or a
+       window refilled from fd that keeps the queued tokens' bytes. */
+    const unsigned char *src;
+    size_t src_len;
+    int mapped;                 /* src is our mmap of the input */
+    unsigned char *win;         /* streaming window, else NULL */
+    size_t win_cap;
+    int fd;                     /* streaming descriptor, -1 once drained */
+    size_t src_off;             /* input offset of src[0] */
+    const unsigned char *cur, *lim;
+    int line;
+    size_t begin_off;           /* where lexing started, at begin_line */
+    int begin_line;
+    size_t tok_off;             /* input offset of the token being scanned */
+    int scanning;               /* inside lex_token(): tok_off is live */
+
+    /* options */
+    int use_index;              /* lex via the structural index (whole buffers only) */
+    int partial;                /* input may end inside a comment: see open_comment */
+    int in_comment;             /* input starts inside a comment opened on this line */
+    size_t comment_off;         /* in_comment, comment_open: the comment's offset */
+    int comment_star;           /* in_comment: the byte before cur is its '*' */
+    int comment_open;           /* inside skip_comment() */
+    InternTable *names;         /* intern identifiers here (may be shared) */
+    TextBuf *literals;          /* decode string/char constants into this pool */
+    LineTable *lines;           /* record line starts here */
+    int caret;                  /* quote the source line in diagnostics */
+    void (*on_error)(void *ctx, int line, const char *msg, const char *context);
+    void *error_ctx;
+
+    int open_comment;           /* partial: start line of a comment open at the end */
+
+    /* token ring */
+    token_t ring[LEXER_RING];
+    unsigned head, count;
+    unsigned batch_from;        /* count when the current refill began */
+    int done;
+
+    /* structural index: entries for [ix_win, ix_end) */
+    IndexEntry *ix;
+    size_t ix_n, ix_i;
+    const unsigned char *ix_win, *ix_end;
+    int ix_line;
+    unsigned ix_prev;
+} lexer_t;
+
+static pthread_once_t lexer_once = PTHREAD_ONCE_INIT;
+
+static lexer_t *lexer_alloc(void) {
+    pthread_once(&lexer_once, lex_simd_init);
+    lexer_t *lx = calloc(1, sizeof *lx);
+    if (lx) { lx->fd = -1; lx->line = lx->begin_line = 1; }
+    return lx;
+}
+
+/* Open a file for lexing: mmap regular files, stream everything else */
+static inline lexer_t *lexer_open(const char *path) {
+    int fd = path ? open(path, O_RDONLY) : 0;
+    if (fd < 0) return NULL;
+    lexer_t *lx = lexer_alloc();
+    if (!lx) { if (fd != 0) close(fd); return NULL; }
+#ifndef _WIN32
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+            madvise(p, (size_t)st.st_size, MADV_WILLNEED);
+            if (fd != 0) close(fd);
+            lx->src = p; lx->src_len = (size_t)st.st_size; lx->mapped = 1;
+            lx->cur = lx->src; lx->lim = lx->src + lx->src_len;
+            return lx;
+        }
+    }
+#endif
+    lx->win_cap = 2 * STREAM_BLOCK;
+    lx->win = malloc(lx->win_cap);
+    if (!lx->win) { if (fd != 0) close(fd); free(lx); return NULL; }
+    lx->fd = fd;
+    lx->src = lx->win; lx->src_len = lx->win_cap;
+    lx->cur = lx->lim = lx->win;
+    return lx;
+}
+
+/* Lex s[begin, end), which starts at the given line; spans are offsets
+   into s. The buffer must outlive the lexer. */
+static inline lexer_t *lexer_open_mem(const unsigned char *s, size_t begin, size_t end, int line) {
+    lexer_t *lx = lexer_alloc();
+    if (!lx) return NULL;
+    lx->src = s; lx->src_len = end;
+    lx->cur = s + begin; lx->lim = s + end;
+    lx->line = lx->begin_line = line;
+    lx->begin_off = lx->comment_off = begin;
+    return lx;
+}
+
+static inline void lexer_close(lexer_t *lx) {
+    if (!lx) return;
+    if (lx->fd > 0) close(lx->fd);
+#ifndef _WIN32
+    if (lx->mapped) munmap((void *)lx->src, lx->src_len);
+#endif
+    free(lx->win);
+    free(lx->ix);
+    free(lx);
+}
+
+/* Lexeme bytes of a token (t->len of them, not NUL-terminated) */
+static inline const char *lexer_text(const lexer_t *lx, const token_t *t) {
+    return (const char *)lx->src + (t->off - lx->src_off);
+}
+
+/* Utility: queue the token running from tok_off to cur */
+static token_t *lex_emit(lexer_t *lx, TokKind tok, int quoted, int line) {
+    token_t *t = &lx->ring[(lx->head + lx->count) % LEXER_RING];
+    t->kind = tok;
+    t->off = lx->tok_off + (size_t)quoted;
+    t->len = lx->src_off + (size_t)(lx->cur - lx->src) - t->off - (size_t)quoted;
+    t->quoted = quoted;
+    t->line = line;
+    t->value = 0;
+    t->out_of_range = 0;
+    t->id = -1;
+    t->lit = t->lit_len = 0;
+    lx->count++;
+    return t;
+}
+
+static void lex_add_line(LineTable *lt, size_t off) {
+    if (lt->n == lt->cap) {
+        lt->cap = lt->cap ? lt->cap * 2 : 1024;
+        size_t *v = realloc(lt->start, lt->cap * sizeof *v);
+        if (!v) { fprintf(stderr, "Out of memory\n"); exit(1); }
+        lt->start = v;
+    }
+    lt->start[lt->n++] = off;
+}
+
+/* Record the starts of the lines passed since the last call */
+static void lex_note_lines(lexer_t *lx) {
+    LineTable *lt = lx->lines;
+    if (!lt) return;
+    if (!lt->n) {
+        lt->first_line = lx->begin_line;
+        lt->done = lx->begin_off;
+        lex_add_line(lt, lt->done);
+    }
+    const unsigned char *p = lx->src + (lt->done - lx->src_off), *q;
+    while (p < lx->cur && (q = memchr(p, '\n', (size_t)(lx->cur - p))) != NULL) {
+        p = q + 1;
+        lex_add_line(lt, lx->src_off + (size_t)(p - lx->src));
+    }
+    if (p < lx->cur) p = lx->cur;
+    lt->done = lx->src_off + (size_t)(p - lx->src);
+}
+
+/* Map an input offset to its line and 1-based byte column */
+static inline void lexer_position(const LineTable *lt, size_t off, int *line, int *col) {
+    size_t lo = 0, hi = lt->n;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (lt->start[mid] <= off) lo = mid;
+        else hi = mid;
+    }
+    *line = lt->first_line + (int)lo;
+    *col = (int)(off - lt->start[lo]) + 1;
+}
+
+/* The source line holding off with a caret under it, while the line is
+   still in the window; tabs are kept so the caret lines up */
+static int lex_context(lexer_t *lx, size_t off, TextBuf *b) {
+    if (!lx->lines || off < lx->src_off) return 0;
+    lex_note_lines(lx);
+    int line, col;
+    lexer_position(lx->lines, off, &line, &col);
+    size_t from = off - (size_t)(col - 1);
+    if (from < lx->src_off) from = lx->src_off;
+    const unsigned char *p = lx->src + (from - lx->src_off), *at = lx->src + (off - lx->src_off);
+    const unsigned char *e = memchr(p, '\n', (size_t)(lx->lim - p));
+    if (!e) e = lx->lim;
+    if (e > p && e[-1] == '\r') e--;
+    buf_printf(b, "%.*s\n", (int)(e - p), (const char *)p);
+    for (; p < at; p++)   /* one column per character: skip UTF-8 continuation bytes */
+        if ((*p & 0xC0) != 0x80) buf_printf(b, "%c", *p == '\t' ? '\t' : ' ');
+    buf_printf(b, "^\n");
+    return 1;
+}
+
+/* Utility: report a lexical error at input offset off */
+static void lex_error(lexer_t *lx, int line, size_t off, const char *msg) {
+    TextBuf ctx = { NULL, 0, 0 };
+    int has_ctx = lx->caret && lex_context(lx, off, &ctx);
+    if (lx->on_error) lx->on_error(lx->error_ctx, line, msg, has_ctx ? ctx.data : NULL);
+    else fprintf(stderr, "Line %d: %s\n%s", line, msg, has_ctx ? ctx.data : "");
+    free(ctx.data);
+}
+
+/* Slide the bytes still needed (queued tokens, the token being scanned
+   and the unread tail) to the front of the window and read() the next
+   block behind them, growing the window while they fill more than half
+   of it. Returns 0 once no more bytes can be added. */
+static int lex_fill(lexer_t *lx) {
+    if (lx->fd < 0) return 0;
+    lex_note_lines(lx);
+    size_t hold = lx->src_off + (size_t)(lx->cur - lx->win);
+    if (lx->scanning && lx->tok_off < hold) hold = lx->tok_off;
+    if (lx->count && TOKEN_BEGIN(&lx->ring[lx->head]) < hold) hold = TOKEN_BEGIN(&lx->ring[lx->head]);
+    /* --caret: keep an open comment's first line for its diagnostic, as
+       long as that takes no more room */
+    if (lx->comment_open && lx->caret && lx->lines && lx->comment_off >= lx->src_off && lx->comment_off < hold) {
+        int line, col;
+        lexer_position(lx->lines, lx->comment_off, &line, &col);
+        size_t from = lx->comment_off - (size_t)(col - 1);
+        if (from < lx->src_off) from = lx->src_off;
+        if (lx->src_off + (size_t)(lx->lim - lx->win) - from <= lx->win_cap / 2) hold = from;
+    }
+    const unsigned char *from = lx->win + (hold - lx->src_off);
+    size_t keep = (size_t)(lx->lim - from), skip = (size_t)(lx->cur - from);
+    memmove(lx->win, from, keep);
+    lx->src_off = hold;
+    if (keep > lx->win_cap / 2) {
+        unsigned char *w = realloc(lx->win, lx->win_cap * 2);
+        if (!w) { fprintf(stderr, "Out of memory\n"); exit(1); }
+        lx->win = w;
+        lx->win_cap *= 2;
+        lx->src = w; lx->src_len = lx->win_cap;
+    }
+    long got;
+    do got = (long)read(lx->fd, lx->win + keep, lx->win_cap - keep);
+    while (got < 0 && errno == EINTR);
+    lx->cur = lx->win + skip;
+    lx->lim = lx->win + keep;
+    if (got <= 0) {
+        if (lx->fd != 0) close(lx->fd);
+        lx->fd = -1;
+        return 0;
+    }
+    lx->lim += got;
+    return 1;
+}
+
+/* Make at least n bytes available at cur; 0 if the input ends first */
+static int lex_need(lexer_t *lx, size_t n) {
+    while ((size_t)(lx->lim - lx->cur) < n)
+        if (!lex_fill(lx)) return 0;
+    return 1;
+}
+
+/* Keywords: a perfect hash on (length, first char, last char), folded to
+   lower case. KW_HASH has no collisions among the eight keywords, so a
+   single probe plus a case-insensitive compare classifies an identifier
+   in place. Identifier bytes are [A-Za-z0-9_], where |0x20 only folds
+   letters, so the compare is exact. */
+#define KW_HASH(n, f, l) (((n) + ((f) | 0x20) + (((l) | 0x20) << 2)) & 15)
+#define KW(s, f, l, tok) [KW_HASH(sizeof(s) - 1, f, l)] = { s, sizeof(s) - 1, tok }
+
+static const struct {
+    const char *text;
+    size_t len;
+    TokKind tok;
+} kw_table[16] = {
+    KW("void",  'v', 'd', TK_VOID),
+    KW("char",  'c', 'r', TK_CHAR),
+    KW("int",   'i', 't', TK_INT),
+    KW("if",    'i', 'f', TK_IF),
+    KW("else",  'e', 'e', TK_ELSE),
+    KW("while", 'w', 'e', TK_WHILE),
+    KW("for",   'f', 'r', TK_FOR),
+    KW("main",  'm', 'n', TK_MAIN),
+};
+
+/* Value of the digit run [p, p+n); 0 if it does not fit in an int.
+   An int has at most ten significant digits: eight go through the
+   SWAR lex_parse8(), the rest one at a time. */
+static int int_value(const unsigned char *p, size_t n, int *value) {
+    while (n > 1 && *p == '0') { p++; n--; }
+    if (n > 10) return 0;
+    uint64_t v = 0;
+    if (n >= 8) { v = lex_parse8(p); p += 8; n -= 8; }
+    while (n--) v = v * 10 + (uint64_t)(*p++ - '0');
+    if (v > INT_MAX) return 0;
+    *value = (int)v;
+    return 1;
+}
+
+/* Check for Keywords */
+static TokKind keyword_or_ident(const unsigned char *lex, size_t n) {
+    if (n < 2 || n > 5) return TK_IDENTIFIER;
+    unsigned h = KW_HASH(n, lex[0], lex[n-1]);
+    if (kw_table[h].len != n) return TK_IDENTIFIER;
+    for (size_t i = 0; i < n; i++)
+        if ((lex[i] | 0x20) != kw_table[h].text[i]) return TK_IDENTIFIER;
+    return kw_table[h].tok;
+}
+
+/* Offset of p in the input */
+#define LEX_OFF(lx, p) ((lx)->src_off + (size_t)((p) - (lx)->src))
+
+/* Report each invalid UTF-8 sequence in the comment bytes [p, e), p being
+   on the given line. Returns where checking stopped: e, or the start of a
+   sequence cut off by e that the next block may complete. */
+static const unsigned char *check_comment_utf8(lexer_t *lx, const unsigned char *p, const unsigned char *e, int line) {
+    const unsigned char *from = p;
+    while ((p = lex_simd.utf8(p, e)) < e) {
+        int k = -lex_utf8_len(p, e);
+        if (p + k == e && lx->fd >= 0) return p;
+        for (const unsigned char *nl; (nl = memchr(from, '\n', (size_t)(p - from))) != NULL; from = nl + 1) line++;
+        from = p;
+        lex_error(lx, line, LEX_OFF(lx, p), "Invalid UTF-8 in comment");
+        p += k;
+    }
+    return e;
+}
+
+/* Streamed input: a refill would have to keep the bytes of the tokens
+   this refill has queued, so hand those out first */
+static int lex_yield(const lexer_t *lx) {
+    return lx->win && lx->count > lx->batch_from;
+}
+
+/* Skip a comment body from cur past its closing delimiter. 1 once past
+   it; 0 if the input ends first; -1 if stopped at the end of the window
+   for lex_yield(), with in_comment set to resume. star: the byte before
+   cur is the body's '*'. */
+static int skip_comment(lexer_t *lx, int start_line, size_t start_off, int star) {
+    lx->comment_off = start_off;
+    lx->comment_open = 1;
+    for (;;) {
+        if (star && lx->cur < lx->lim && *lx->cur == '/') { lx->cur++; lx->comment_open = 0; return 1; }
+        const unsigned char *body = lx->cur;
+        int body_line = lx->line;
+        const unsigned char *end = lex_simd.comment_end(lx->cur, lx->lim, &lx->line);
+        if (end) {
+            check_comment_utf8(lx, body, end, body_line);
+            lx->cur = end + 2;
+            lx->comment_open = 0;
+            return 1;
+        }
+        if (lx->lim > lx->cur) star = lx->lim[-1] == '*';   /* an empty window leaves it as it was */
+        lx->cur = check_comment_utf8(lx, body, lx->lim, body_line);
+        if (lex_yield(lx)) {
+            lx->in_comment = start_line;
+            lx->comment_star = star;
+            lx->comment_open = 0;
+            return -1;
+        }
+        if (!lex_fill(lx)) {
+            check_comment_utf8(lx, lx->cur, lx->lim, lx->line);   /* a sequence cut off by the end */
+            /* a partial range's end is not the end of input: leave it to the caller */
+            if (lx->partial) lx->open_comment = start_line;
+            else lex_error(lx, start_line, start_off, "Un-terminated comments");
+            lx->comment_open = 0;
+            return 0;
+        }
+    }
+}
+
+/* Up to the next token or the end of input; 0 if stopped short of them
+   for lex_yield() */
+static int skip_ws_and_comments(lexer_t *lx) {
+    if (lx->in_comment) {
+        int start_line = lx->in_comment, star = lx->comment_star;
+        lx->in_comment = lx->comment_star = 0;
+        int r = skip_comment(lx, start_line, lx->comment_off, star);
+        if (r <= 0) return r == 0;
+    }
+    for (;;) {
+        if (lx->cur == lx->lim && lex_yield(lx)) return 0;
+        if (!lex_need(lx, 1)) return 1;
+        lx->cur = lex_simd.ws(lx->cur, lx->lim, &lx->line);
+        if (lx->cur == lx->lim) continue;
+
+        if (*lx->cur == '/') {
+            if (lx->cur + 1 == lx->lim && lex_yield(lx)) return 0;
+            if (lex_need(lx, 2) && lx->cur[1] == '*') {
+                int start_line = lx->line;
+                size_t start_off = LEX_OFF(lx, lx->cur);
+                lx->cur += 2;
+                int r = skip_comment(lx, start_line, start_off, 0);
+                if (r <= 0) return r == 0;
+                continue;
+            }
+        }
+        return 1;
+    }
+}
+
+/* Byte value of the escape \c. Escapes are a backslash and one character,
+   as the scanners read them. */
+static int lex_escape(int c) {
+    switch (c) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case '0': return '\0';
+    case 'a': return '\a';
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    default:  return c;     /* \\ \' \" \? and the rest stand for themselves */
+    }
+}
+
+/* Decode the constant body [p, e) onto the end of the literal pool */
+static void lex_decode(TextBuf *pool, const unsigned char *p, const unsigned char *e, token_t *t) {
+    buf_reserve(pool, (size_t)(e - p) + 1);
+    char *d0 = pool->data + pool->len, *d = d0;
+    for (;;) {
+        const unsigned char *bs = memchr(p, '\\', (size_t)(e - p));
+        size_t run = (size_t)((bs ? bs : e) - p);
+        memcpy(d, p, run);
+        d += run;
+        if (!bs) break;
+        *d++ = (char)lex_escape(bs[1]);
+        p = bs + 2;
+    }
+    *d = 0;
+    t->lit = pool->len;
+    t->lit_len = (size_t)(d - d0);
+    pool->len += t->lit_len + 1;
+}
+
+/* Check the body [tok_off + 1, cur - 1) of a just-scanned string or char
+   constant; 0 (after reporting) if it is not valid UTF-8 */
+static int check_literal_utf8(lexer_t *lx, int line, const char *msg) {
+    const unsigned char *body = lx->src + (lx->tok_off - lx->src_off) + 1, *end = lx->cur - 1;
+    const unsigned char *bad = lex_simd.utf8(body, end);
+    if (bad == end) return 1;
+    lex_error(lx, line, LEX_OFF(lx, bad), msg);
+    return 0;
+}
+
+static void scan_string(lexer_t *lx) {
+    int start_line = lx->line;
+    while (lex_need(lx, 1)) {
+        int c = *lx->cur++;
+        if (c == '\n') { lx->line++; break; }
+        if (c == '"') {
+            if (check_literal_utf8(lx, start_line, "Invalid UTF-8 in string constant")) {
+                token_t *t = lex_emit(lx, TK_STRING_CONST, 1, start_line);
+                if (lx->literals) lex_decode(lx->literals, lx->cur - 1 - t->len, lx->cur - 1, t);
+            }
+            return;
+        }
+        if (c == '\\') {
+            if (!lex_need(lx, 1)) break;
+            if (*lx->cur++ == '\n') { lx->line++; break; }
+        }
+    }
+    lex_error(lx, start_line, lx->tok_off, "String constants exceed line");
+}
+
+/* Consume up to and including the next quote or newline after a bad char constant */
+static void skip_bad_char(lexer_t *lx) {
+    while (lex_need(lx, 1)) {
+        int c = *lx->cur++;
+        if (c == '\n') { lx->line++; return; }
+        if (c == '\'') return;
+    }
+}
+
+static void scan_char(lexer_t *lx) {
+    int start_line = lx->line;
+    if (!lex_need(lx, 1) || *lx->cur == '\'' || *lx->cur == '\n') {
+        if (lx->cur < lx->lim) { if (*lx->cur == '\n') lx->line++; lx->cur++; }
+        lex_error(lx, start_line, lx->tok_off, "Char constant too long");
+        return;
+    }
+    if (*lx->cur++ == '\\') {
+        if (!lex_need(lx, 1) || *lx->cur == '\n') {
+            if (lx->cur < lx->lim) { lx->line++; lx->cur++; }
+            lex_error(lx, start_line, lx->tok_off, "Char constant too long");
+            return;
+        }
+        lx->cur++;
+    }
+    if (!lex_need(lx, 1) || *lx->cur != '\'') {
+        lex_error(lx, start_line, lx->tok_off, "Char constant too long");
+        skip_bad_char(lx);
+        return;
+    }
+    lx->cur++;
+    if (check_literal_utf8(lx, start_line, "Invalid UTF-8 in char constant")) {
+        token_t *t = lex_emit(lx, TK_CHAR_CONST, 1, start_line);
+        const unsigned char *body = lx->cur - 1 - t->len;
+        t->value = *body == '\\' ? lex_escape(body[1]) : *body;
+        if (lx->literals) lex_decode(lx->literals, body, lx->cur - 1, t);
+    }
+}
+
+static void skip_line_after_error(lexer_t *lx) {
+    lx->scanning = 0;   /* the bad token is reported: its bytes need not stay */
+    do {
+        const unsigned char *nl = memchr(lx->cur, '\n', (size_t)(lx->lim - lx->cur));
+        if (nl) { lx->line++; lx->cur = nl + 1; return; }
+        lx->cur = lx->lim;
+    } while (lex_fill(lx));
+}
+
+/* The DFA accepts lex_tokens.def entries by 1-based index, as TokKind numbers them */
+typedef char lex_kinds_match[sizeof lex_token_name / sizeof *lex_token_name == TK_IDENTIFIER ? 1 : -1];
+
+/* Lex one token at cur, which is neither blank nor a comment */
+static void lex_token_at(lexer_t *lx) {
+    int c = *lx->cur++;
+
+    unsigned state = lex_delta[LEX_S_START][lex_class[c]];
+
+    if (state >= LEX_S_FIRST_OP) {
+        /* longest match through the operator trie, peeking ahead */
+        unsigned best = lex_accept[state], next;
+        size_t k = 0, best_k = 0;
+        while (lex_need(lx, k + 1) && (next = lex_delta[state][lex_class[lx->cur[k]]]) != LEX_S_ERROR) {
+            state = next; k++;
+            if (lex_accept[state]) { best = lex_accept[state]; best_k = k; }
+        }
+        if (best) {
+            lx->cur += best_k;
+            lex_emit(lx, (TokKind)best, 0, lx->line);   /* accept index == kind */
+            return;
+        }
+    }
+
+    if (state == LEX_S_IDENT) {
+        for (;;) {
+            lx->cur = lex_simd.ident(lx->cur, lx->lim);
+            if (lx->cur < lx->lim || !lex_fill(lx)) break;
+        }
+        const unsigned char *p = lx->src + (lx->tok_off - lx->src_off);
+        size_t n = (size_t)(lx->cur - p);
+        TokKind tk = keyword_or_ident(p, n);
+        token_t *t = lex_emit(lx, tk, 0, lx->line);
+        if (tk == TK_IDENTIFIER && lx->names) t->id = (int)intern(lx->names, (const char *)p, n);
+        return;
+    }
+
+    if (state == LEX_S_NUMBER) {
+        for (;;) {
+            lx->cur = lex_simd.digits(lx->cur, lx->lim);
+            if (lx->cur < lx->lim || !lex_fill(lx)) break;
+        }
+        token_t *t = lex_emit(lx, TK_INT_CONST, 0, lx->line);
+        if (!int_value(lx->src + (lx->tok_off - lx->src_off), t->len, &t->value)) {
+            t->value = INT_MAX;
+            t->out_of_range = 1;
+            lex_error(lx, t->line, lx->tok_off, "Integer constant out of range");
+        }
+        return;
+    }
+
+    if (state == LEX_S_STRING) { scan_string(lx); return; }
+    if (state == LEX_S_CHAR)   { scan_char(lx); return; }
+
+    lex_error(lx, lx->line, lx->tok_off, "Undefined symbol");
+    skip_line_after_error(lx);
+}
+
+static void lex_token(lexer_t *lx) {
+    lx->tok_off = lx->src_off + (size_t)(lx->cur - lx->src);
+    lx->scanning = 1;
+    lex_token_at(lx);
+    lx->scanning = 0;
+}
+
+/* ---------- Structural index (whole buffers) ----------
+   Stage 1 classifies the source 64 bytes at a time and records every
+   byte where a token can start, together with its line number. Stage 2
+   visits only those positions and materialises tokens with the usual
+   scanners, dropping positions already consumed by an earlier token,
+   string, char constant, comment or error skip. A position can start a
+   token unless it is blank or continues an identifier/number run; the
+   index is a superset of the real token starts, so the output is the
+   same as sequential lexing. */
+
+/* Stage 1 over [w, w+n): fills ix, returns the number of entries.
+   *line is the line number at w; prev carries the ident/digit bits of
+   the byte before w (bit 0 / bit 1). */
+static size_t build_index(const unsigned char *w, size_t n, IndexEntry *ix, int *line, unsigned *prev) {
+    size_t k = 0;
+    for (size_t b = 0; b < n; b += 64) {
+        LexBlockMasks m;
+        if (n - b >= 64) {
+            lex_simd.classify64(w + b, &m);
+        } else {
+            unsigned char pad[64];
+            memset(pad, ' ', sizeof(pad));
+            memcpy(pad, w + b, n - b);
+            lex_simd.classify64(pad, &m);
+        }
+        uint64_t prev_ident = (m.ident << 1) | (*prev & 1);
+        uint64_t prev_digit = (m.digit << 1) | ((*prev >> 1) & 1);
+        uint64_t starts = ~m.blank & (~(m.ident & prev_ident) | (m.ident & ~m.digit & prev_digit));
+        if (n - b < 64) starts &= ((uint64_t)1 << (n - b)) - 1;
+        *prev = (unsigned)(m.ident >> 63) | (unsigned)(m.digit >> 63) << 1;
+
+        while (starts) {
+            int i = lex_ctz64(starts);
+            ix[k].off = (uint32_t)(b + (size_t)i);
+            ix[k].line = *line + lex_popcount64(m.nl & (((uint64_t)1 << i) - 1));
+            k++;
+            starts &= starts - 1;
+        }
+        *line += lex_popcount64(m.nl);
+    }
+    return k;
+}
+
+/* One stage-2 step: visit the next indexed position, indexing the next
+   window when this one is used up */
+static void lex_index_step(lexer_t *lx) {
+    if (!lx->ix) {
+        if (lx->win || !(lx->ix = malloc(INDEX_WINDOW * sizeof *lx->ix))) { lx->use_index = 0; return; }
+        if (lx->in_comment) skip_ws_and_comments(lx);
+        lx->ix_win = lx->ix_end = lx->cur;
+        lx->ix_line = lx->line;
+    }
+    if (lx->ix_i == lx->ix_n) {
+        if (lx->ix_end >= lx->lim) { lx->done = 1; return; }
+        size_t n = (size_t)(lx->lim - lx->ix_end);
+        if (n > INDEX_WINDOW) n = INDEX_WINDOW;
+        lx->ix_win = lx->ix_end;
+        lx->ix_end += n;
+        lx->ix_n = build_index(lx->ix_win, n, lx->ix, &lx->ix_line, &lx->ix_prev);
+        lx->ix_i = 0;
+        return;
+    }
+    const IndexEntry *e = &lx->ix[lx->ix_i++];
+    const unsigned char *p = lx->ix_win + e->off;
+    if (p < lx->cur) return;
+    lx->cur = p;
+    lx->line = e->line;
+    if (*p == '/' && p + 1 < lx->lim && p[1] == '*') skip_ws_and_comments(lx);
+    else lex_token(lx);
+}
+
+/* Lex until the ring is full or the input ends, or for a streamed input
+   until the window runs out with tokens queued */
+static void lex_refill(lexer_t *lx) {
+    lx->batch_from = lx->count;
+    while (lx->count < LEXER_RING && !lx->done) {
+        if (lx->use_index) { lex_index_step(lx); continue; }
+        if (!skip_ws_and_comments(lx)) break;
+        if (!lex_need(lx, 1)) { lx->done = 1; break; }
+        lex_token(lx);
+    }
+    lex_note_lines(lx);
+}
+
+/* Pull the next token; 0 at the end of input */
+static inline int lexer_next(lexer_t *lx, token_t *t) {
+    if (!lx->count) lex_refill(lx);
+    if (!lx->count) return 0;
+    *t = lx->ring[lx->head];
+    lx->head = (lx->head + 1) % LEXER_RING;
+    lx->count--;
+    return 1;
+}
+
+/* Look k tokens ahead (0: the token lexer_next() returns next) without
+   consuming; 0 if the input ends first. k must be below LEXER_RING. */
+static inline int lexer_peek(lexer_t *lx, unsigned k, token_t *t) {
+    while (lx->count <= k && !lx->done) lex_refill(lx);
+    if (lx->count <= k) return 0;
+    *t = lx->ring[(lx->head + k) % LEXER_RING];
+    return 1;
+}
+
+/* ---------- Incremental re-lexing ----------
+   Lexing is context free between tokens: whatever precedes a token
+   start, the lexer is in its start state there. So after an edit it is
+   enough to resume at the end of the last token that neither overlaps
+   the edit nor peeks into it (scanners look one byte past a token, the
+   longest operator being two bytes), and to stop at the first new token
+   start, past the edit, where an old token started too. From there on
+   the old stream is still right, shifted by the edit's size. */
+
+/* on_error hook collecting diagnostics into a TextBuf */
+static inline void lex_error_to_buf(void *ctx, int line, const char *msg, const char *context) {
+    buf_printf(ctx, "Line %d: %s\n%s", line, msg, context ? context : "");
+}
+
+typedef struct {
+    token_t *v;
+    size_t n, cap;
+    const unsigned char *base;  /* source the spans point into */
+    TextBuf errs;               /* diagnostics of the last (re-)lex */
+    InternTable *names;         /* optional: ids stay stable across edits */
+    TextBuf *literals;          /* optional: re-lexed constants are appended */
+} TokList;
+
+typedef struct {
+    size_t off, removed;        /* replaced byte range of the old source */
+    const char *text;           /* replacement text */
+    size_t inserted;            /* its length */
+} LexEdit;
+
+typedef struct {
+    size_t first;               /* index of the first re-lexed token */
+    size_t old_count;           /* old tokens replaced from there */
+    size_t new_count;           /* new tokens in their place */
+} TokRange;
+
+static void reserve_spans(TokList *l, size_t n) {
+    if (n <= l->cap) return;
+    size_t cap = l->cap ? l->cap : 1024;
+    while (cap < n) cap *= 2;
+    token_t *v = realloc(l->v, cap * sizeof *v);
+    if (!v) { fprintf(stderr, "Out of memory\n"); exit(1); }
+    l->v = v; l->cap = cap;
+}
+
+/* Move the tokens queued in lx onto the end of l */
+static void take_spans(TokList *l, lexer_t *lx) {
+    reserve_spans(l, l->n + lx->count);
+    for (; lx->count; lx->count--, lx->head = (lx->head + 1) % LEXER_RING)
+        l->v[l->n++] = lx->ring[lx->head];
+}
+
+/* Lex all of s[0, n) into l */
+static inline void lex_collect(TokList *l, const unsigned char *s, size_t n) {
+    l->n = 0; l->errs.len = 0; l->base = s;
+    lexer_t *lx = lexer_open_mem(s, 0, n, 1);
+    if (!lx) { fprintf(stderr, "Out of memory\n"); exit(1); }
+    lx->on_error = lex_error_to_buf; lx->error_ctx = &l->errs;
+    lx->names = l->names;
+    lx->literals = l->literals;
+    while (!lx->done) {
+        lex_refill(lx);
+        take_spans(l, lx);
+    }
+    lexer_close(lx);
+}
+
+/* Update l, the tokens of the old source, for s[0, n): the old source
+   with edit e applied. r receives the token range that changed;
+   l->errs holds the diagnostics of the re-lexed region only. */
+static inline void relex(TokList *l, const unsigned char *s, size_t n, const LexEdit *e, TokRange *r) {
+    size_t lo = 0, hi = l->n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (TOKEN_END(&l->v[mid]) < e->off) lo = mid + 1;
+        else hi = mid;
+    }
+    size_t first = lo;
+
+    TokList fresh = { NULL, 0, 0, s, { NULL, 0, 0 }, l->names, l->literals };
+    lexer_t *lx = lexer_open_mem(s, first ? TOKEN_END(&l->v[first-1]) : 0, n,
+                                 first ? l->v[first-1].line : 1);
+    if (!lx) { fprintf(stderr, "Out of memory\n"); exit(1); }
+    lx->on_error = lex_error_to_buf; lx->error_ctx = &fresh.errs;
+    lx->names = l->names;
+    lx->literals = l->literals;
+
+    size_t edit_end = e->off + e->inserted, j = first;
+    for (;;) {
+        skip_ws_and_comments(lx);
+        if (!lex_need(lx, 1)) { j = l->n; break; }
+        size_t at = (size_t)(lx->cur - s);
+        if (at >= edit_end) {
+            size_t old_at = at - e->inserted + e->removed;
+            while (j < l->n && TOKEN_BEGIN(&l->v[j]) < old_at) j++;
+            if (j < l->n && TOKEN_BEGIN(&l->v[j]) == old_at) break;
+        }
+        lex_token(lx);
+        take_spans(&fresh, lx);
+    }
+
+    /* splice: keep [0, first), insert fresh, shift the old tail [j, n) */
+    int dline = j < l->n ? lx->line - l->v[j].line : 0;
+    lexer_close(lx);
+    for (size_t i = j; i < l->n; i++) {
+        l->v[i].off = l->v[i].off - e->removed + e->inserted;
+        l->v[i].line += dline;
+    }
+    size_t tail = l->n - j, total = first + fresh.n + tail;
+    reserve_spans(l, total);
+    memmove(l->v + first + fresh.n, l->v + j, tail * sizeof *l->v);
+    if (fresh.n) memcpy(l->v + first, fresh.v, fresh.n * sizeof *l->v);
+    l->n = total;
+    l->base = s;
+    free(l->errs.data);
+    l->errs = fresh.errs;
+    free(fresh.v);
+
+    r->first = first;
+    r->old_count = j - first;
+    r->new_count = fresh.n;
+}
+
+#endif /* LEXER_H */
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Table generator for the lexer DFA.
+   Reads the fixed-spelling tokens from lex_tokens.def and prints
+   lex_tables.h: a 256-entry character-class table, a transition table
+   over (state, class) and the token accepted in each state.
+
+   Usage: gcc lexgen.c -o lexgen && ./lexgen > lex_tables.h */
+
+typedef struct {
+    const char *name;
+    const char *text;
+} Spec;
+
+static const Spec spec[] = {
+#define LEX_TOKEN(name, text) { #name, text },
+#include "lex_tokens.def"
+#undef LEX_TOKEN
+};
+#define NSPEC ((int)(sizeof(spec) / sizeof(spec[0])))
+
+/* Fixed classes; every other byte used by a spelling gets its own class */
+enum { C_OTHER, C_ALPHA, C_DIGIT, C_DQUOTE, C_SQUOTE, C_FIRST_OP };
+
+/* Fixed states; operator trie states follow */
+enum { S_ERROR, S_START, S_IDENT, S_NUMBER, S_STRING, S_CHAR, S_FIRST_OP };
+
+#define MAXSTATE 256
+#define MAXCLASS 64
+
+static int cls[256];
+static int nclass = C_FIRST_OP;
+static int delta[MAXSTATE][MAXCLASS];
+static int accept[MAXSTATE];
+static int nstate = S_FIRST_OP;
+
+static int fixed_class(int c) {
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') return C_ALPHA;
+    if (c >= '0' && c <= '9') return C_DIGIT;
+    if (c == '"') return C_DQUOTE;
+    if (c == '\'') return C_SQUOTE;
+    if (c == ' ' || (c >= '\t' && c <= '\r')) return -1;
+    return C_OTHER;
+}
+
+static void print_string(const char *t) {
+    putchar('"');
+    for (; *t; t++) {
+        if (*t == '\\' || *t == '"') putchar('\\');
+        putchar(*t);
+    }
+    putchar('"');
+}
+
+int main(void) {
+    for (int c = 0; c < 256; c++) cls[c] = fixed_class(c) < 0 ? C_OTHER : fixed_class(c);
+
+    for (int i = 0; i < NSPEC; i++) {
+        const unsigned char *t = (const unsigned char *)spec[i].text;
+        if (!*t) { fprintf(stderr, "%s: empty spelling\n", spec[i].name); return 1; }
+        for (; *t; t++) {
+            if (fixed_class(*t) != C_OTHER) {
+                fprintf(stderr, "%s: '%c' cannot start or continue an operator\n", spec[i].name, *t);
+                return 1;
+            }
+            if (cls[*t] == C_OTHER) {
+                if (nclass >= MAXCLASS) { fprintf(stderr, "too many classes\n"); return 1; }
+                cls[*t] = nclass++;
+            }
+        }
+    }
+
+    delta[S_START][C_ALPHA]  = S_IDENT;
+    delta[S_START][C_DIGIT]  = S_NUMBER;
+    delta[S_START][C_DQUOTE] = S_STRING;
+    delta[S_START][C_SQUOTE] = S_CHAR;
+
+    /* operator spellings form a trie hanging off S_START */
+    for (int i = 0; i < NSPEC; i++) {
+        int s = S_START;
+        for (const unsigned char *t = (const unsigned char *)spec[i].text; *t; t++) {
+            int k = cls[*t];
+            if (!delta[s][k]) {
+                if (nstate >= MAXSTATE) { fprintf(stderr, "too many states\n"); return 1; }
+                delta[s][k] = nstate++;
+            }
+            s = delta[s][k];
+        }
+        if (accept[s]) {
+            fprintf(stderr, "%s: duplicate spelling \"%s\"\n", spec[i].name, spec[i].text);
+            return 1;
+        }
+        accept[s] = i + 1;
+    }
+
+    printf("/* Generated by lexgen.c from lex_tokens.def - do not edit. */\n\n");
+    printf("#ifndef LEX_TABLES_H\n#define LEX_TABLES_H\n\n");
+    printf("enum {\n    LEX_S_ERROR, LEX_S_START, LEX_S_IDENT, LEX_S_NUMBER,\n"
+           "    LEX_S_STRING, LEX_S_CHAR, LEX_S_FIRST_OP\n};\n\n");
+    printf("#define LEX_NSTATES %d\n#define LEX_NCLASSES %d\n\n", nstate, nclass);
+
+    printf("static const unsigned char lex_class[256] = {");
+    for (int c = 0; c < 256; c++)
+        printf("%s%2d,", c % 16 ? " " : "\n    ", cls[c]);
+    printf("\n};\n\n");
+
+    printf("static const unsigned char lex_delta[LEX_NSTATES][LEX_NCLASSES] = {\n");
+    for (int s = 0; s < nstate; s++) {
+        printf("    {");
+        for (int k = 0; k < nclass; k++) printf("%s%d", k ? "," : "", delta[s][k]);
+        printf("},\n");
+    }
+    printf("};\n\n");
+
+    /* 1-based index into lex_token_name/lex_token_text, 0 = not accepting */
+    printf("static const unsigned char lex_accept[LEX_NSTATES] = {");
+    for (int s = 0; s < nstate; s++) printf("%s%d", s ? "," : "", accept[s]);
+    printf("};\n\n");
+
+    printf("static const char *const lex_token_name[%d] = {\n    0,", NSPEC + 1);
+    for (int i = 0; i < NSPEC; i++) printf(" \"%s\",", spec[i].name);
+    printf("\n};\n\n");
+    printf("static const char *const lex_token_text[%d] = {\n    0,", NSPEC + 1);
+    for (int i = 0; i < NSPEC; i++) { putchar(' '); print_string(spec[i].text); putchar(','); }
+    printf("\n};\n\n");
+
+    printf("#endif /* LEX_TABLES_H */\n");
+    return 0;
+}
@@ -1,227 +1,570 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <pthread.h>
+
+#include "lexer.h"
+#include "tokfile.h"
+#include "tokarc.h"
+#include "outbuf.h"
+#include "tokring.h"
+#include "tarjuman.h"
 
 typedef struct {
     const char *name;
 } TokName;
 
-static int line_no = 1;
-static FILE *in;
-static FILE *out;
-
-/* Utility: write a token row */
-static void emit(const char *tok, const char *lex, int line) {
-    fprintf(out, "%s\t%s\t%d\n", tok, lex ? lex : "", line);
-}
-
-/* Read next character with line tracking */
-static int getc_track(void) {
-    int c = fgetc(in);
-    if (c == '\n') line_no++;
-    return c;
-}
-
-/* Push back a character with line tracking fix */
-static void ungetc_track(int c) {
-    if (c == EOF) return;
-    if (c == '\n') line_no--;
-    ungetc(c, in);
-}
-
-static int is_ident_start(int c) { return isalpha(c) || c == '_'; }
-static int is_ident_part (int c) { return isalnum(c) || c == '_'; }
-
-/* Check for Keywords */
-static const char* keyword_or_ident(const char *lex) {
-    char temp[64];
-    for (int i=0; lex[i] && i<63; i++) temp[i]=toupper((unsigned char)lex[i]);
-    temp[strlen(lex)]='\0';
-    if (strcmp(temp,"VOID")==0)  return "VOID";
-    if (strcmp(temp,"CHAR")==0)  return "CHAR";
-    if (strcmp(temp,"INT")==0)   return "INT";
-    if (strcmp(temp,"IF")==0)    return "IF";
-    if (strcmp(temp,"ELSE")==0)  return "ELSE";
-    if (strcmp(temp,"WHILE")==0) return "WHILE";
-    if (strcmp(temp,"FOR")==0)   return "FOR";
-    if (strcmp(temp,"MAIN")==0)  return "MAIN";
-    return "IDENTIFIER";
-}
-
-static void skip_ws_and_comments(void) {
-    for (;;) {
-        int c = getc_track();
-        if (c == EOF) return;
-        if (c==' '||c=='\t'||c=='\r'||c=='\v'||c=='\f'||c=='\n') continue;
-
-        if (c == '/') {
-            int d = getc_track();
-            if (d == '*') {
-                int prev = 0, cur;
-                int start_line = line_no;
-                int closed = 0;
-                while ((cur = getc_track()) != EOF) {
-                    if (prev == '*' && cur == '/') { closed = 1; break; }
-                    prev = cur;
-                }
-                if (!closed) {
-                    fprintf(stderr, "Line %d: Un-terminated comments\n", start_line);
-                    return;
-                }
-                continue;
-            } else {
-                ungetc_track(d);
-                ungetc_track(c);
-                return;
-            }
-        }
+static OutBuf out = { -1, 0, 0, NULL };   /* tokens.txt, with --text */
+static const unsigned char *source;         /* lex this instead of a file */
+static size_t source_len;
 
-        ungetc_track(c);
-        return;
-    }
+/* ---------- tokens.bin writer ----------
+   Records stream through stdio behind a placeholder header. The string
+   pool stays in memory and goes last, then the header is filled in. For
+   the tarjuman driver the records gather in memory instead (bin_keep). */
+
+static FILE *bin;
+static int bin_keep;
+static TextBuf recs;            /* records, with bin_keep */
+static TokFileHeader hdr;
+static TextBuf pool;
+static InternTable names;       /* identifier ids */
+static TextBuf lits;            /* constants the lexer decoded, for the pool */
+static uint64_t *name_text;     /* id -> pool offset of the name, or ~0 */
+static size_t name_cap;
+
+static uint64_t pool_add(const char *s, size_t n) {
+    buf_reserve(&pool, n + 1);
+    memcpy(pool.data + pool.len, s, n);
+    pool.data[pool.len + n] = 0;
+    uint64_t at = pool.len;
+    pool.len += n + 1;
+    return at;
 }
 
-static void scan_string(void) {
-    char buf[1024]; int i=0;
-    int start_line = line_no;
-    for (;;) {
-        int c = getc_track();
-        if (c == EOF || c == '\n') {
-            fprintf(stderr, "Line %d: String constants exceed line\n", start_line);
-            return;
-        }
-        if (c == '"') {
-            buf[i] = 0;
-            emit("STRING_CONST", buf, start_line);
-            return;
-        }
-        if (c == '\\') {
-            int e = getc_track();
-            if (e == EOF || e == '\n') {
-                fprintf(stderr, "Line %d: String constants exceed line\n", start_line);
-                return;
-            }
-            if (i < (int)sizeof(buf)-2) { buf[i++]='\\'; buf[i++]=(char)e; }
-        } else {
-            if (i < (int)sizeof(buf)-1) buf[i++] = (char)c;
-        }
+/* Pool offset of an identifier's name, stored once per id */
+static uint64_t name_at(int id, const char *text, size_t len) {
+    if ((size_t)id >= name_cap) {
+        size_t cap = name_cap ? name_cap : 1024;
+        while (cap <= (size_t)id) cap *= 2;
+        name_text = intern_alloc(name_text, cap * sizeof *name_text);
+        memset(name_text + name_cap, 0xFF, (cap - name_cap) * sizeof *name_text);
+        name_cap = cap;
     }
+    if (name_text[id] == UINT64_MAX) name_text[id] = pool_add(text, len);
+    return name_text[id];
 }
 
-static void scan_char(void) {
-    char buf[8]; int i=0;
-    int start_line = line_no;
-    int c = getc_track();
-    if (c == '\\') {
-        int e = getc_track();
-        if (e == EOF || e == '\n') {
-            fprintf(stderr, "Line %d: Char constant too long\n", start_line);
-            return;
-        }
-        buf[i++]='\\'; buf[i++]=(char)e;
-        c = getc_track();
-        if (c != '\'') {
-            fprintf(stderr, "Line %d: Char constant too long\n", start_line);
-            while (c != EOF && c != '\n' && c != '\'') c = getc_track();
-            return;
-        }
-        buf[i]=0;
-        emit("CHAR_CONST", buf, start_line);
-    } else if (c == '\'' || c == '\n' || c == EOF) {
-        fprintf(stderr, "Line %d: Char constant too long\n", start_line);
-        return;
+/* Append one record; the lexeme is text[0, t->len), a string constant's
+   decoded bytes are at lit + t->lit */
+static void bin_put(const token_t *t, const char *text, const char *lit) {
+    TokRecord r;
+    r.kind = (uint16_t)t->kind;
+    r.flags = (uint16_t)((t->quoted ? TOK_QUOTED : 0) | (t->out_of_range ? TOK_OUT_OF_RANGE : 0));
+    r.line = t->line;
+    r.value = t->value;
+    r.len = (uint32_t)t->len;
+    r.off = t->off;
+    if (t->kind == TK_IDENTIFIER) {
+        r.value = t->id >= 0 ? t->id : (int32_t)intern(&names, text, t->len);
+        r.text = name_at(r.value, text, t->len);
     } else {
-        int end = getc_track();
-        if (end != '\'') {
-            fprintf(stderr, "Line %d: Char constant too long\n", start_line);
-            while (end != EOF && end != '\n' && end != '\'') end = getc_track();
-            return;
+        r.text = pool_add(text, t->len);
+        if (t->kind == TK_STRING_CONST) {   /* decoded bytes follow */
+            pool_add(lit + t->lit, t->lit_len);
+            r.value = (int32_t)t->lit_len;
         }
-        buf[0]=(char)c; buf[1]=0;
-        emit("CHAR_CONST", buf, start_line);
     }
+    if (bin_keep) {
+        buf_reserve(&recs, sizeof r);
+        memcpy(recs.data + recs.len, &r, sizeof r);
+        recs.len += sizeof r;
+    }
+    else fwrite(&r, sizeof r, 1, bin);
+    hdr.ntok++;
+}
+
+static int tokbin_open(const char *path) {
+    bin = fopen(path, "wb");
+    if (!bin) return 0;
+    static char vbuf[1 << 16];
+    setvbuf(bin, vbuf, _IOFBF, sizeof vbuf);
+    fwrite(&hdr, sizeof hdr, 1, bin);
+    pool_add("", 0);
+    return 1;
+}
+
+/* Add the kind names to the pool and fill in the header */
+static void tokbin_header(uint64_t *kind_text) {
+    for (int k = 0; k < TK_NKINDS; k++) kind_text[k] = pool_add(tok_kind_name[k], strlen(tok_kind_name[k]));
+    memcpy(hdr.magic, TOKFILE_MAGIC, sizeof hdr.magic);
+    hdr.version = TOKFILE_VERSION;
+    hdr.byte_order = TOKFILE_BYTE_ORDER;
+    hdr.record_size = sizeof(TokRecord);
+    hdr.nkinds = TK_NKINDS;
+    hdr.nnames = names.count;
+    hdr.records = sizeof hdr;
+    hdr.kinds = hdr.records + hdr.ntok * sizeof(TokRecord);
+    hdr.pool = hdr.kinds + TK_NKINDS * sizeof *kind_text;
+    hdr.pool_len = pool.len;
+    free(name_text);
+    name_text = NULL;
+    name_cap = 0;
+    intern_free(&names);
+}
+
+static int tokbin_close(void) {
+    uint64_t kind_text[TK_NKINDS];
+    tokbin_header(kind_text);
+    fwrite(kind_text, sizeof kind_text, 1, bin);
+    fwrite(pool.data, 1, pool.len, bin);
+    fseek(bin, 0, SEEK_SET);
+    fwrite(&hdr, sizeof hdr, 1, bin);
+    int ok = !ferror(bin);
+    if (fclose(bin) != 0) ok = 0;
+    bin = NULL;
+    free(pool.data);
+    memset(&pool, 0, sizeof pool);
+    return ok;
+}
+
+/* Hand the tokens over as a TokFile on the writer's buffers, which stay
+   allocated for the rest of the process */
+static void tokbin_hand_over(TokFile *tf) {
+    static uint64_t kind_text[TK_NKINDS];
+    tokbin_header(kind_text);
+    tf->h = &hdr;
+    tf->rec = (const TokRecord *)recs.data;
+    tf->kinds = kind_text;
+    tf->pool = pool.data;
+    tf->size = 0;
+}
+
+/* ---------- tokens.tka writer (--archive) ----------
+   Tokens gather in one block's columns, which go out when the block
+   fills. Every lexeme is interned into the dictionary; it goes last with
+   the index and kind names, then the header is filled in. */
+
+static FILE *arc;
+static TokArcHeader ahdr;
+static InternTable lexdict;
+static unsigned char arc_kinds[TOKARC_BLOCK];
+static TextBuf arc_ids, arc_lines;
+static TokArcBlock arc_cur;
+static int arc_prev_line;
+static TokArcBlock *arc_index;
+static size_t arc_index_cap;
+static uint64_t arc_off;        /* file offset of the next block */
+
+static void put_varint(TextBuf *b, uint64_t v) {
+    buf_reserve(b, 10);
+    while (v >= 0x80) { b->data[b->len++] = (char)(v | 0x80); v >>= 7; }
+    b->data[b->len++] = (char)v;
 }
 
-static void skip_line_after_error(void) {
-    int c;
-    while ((c = getc_track()) != EOF) {
-        if (c == '\n') break;
+static void arc_flush_block(void) {
+    if (!arc_cur.count) return;
+    arc_cur.off = arc_off;
+    arc_cur.ids_len = (uint32_t)arc_ids.len;
+    arc_cur.lines_len = (uint32_t)arc_lines.len;
+    fwrite(arc_kinds, 1, arc_cur.count, arc);
+    fwrite(arc_ids.data, 1, arc_ids.len, arc);
+    fwrite(arc_lines.data, 1, arc_lines.len, arc);
+    arc_off += arc_cur.count + arc_ids.len + arc_lines.len;
+    if (ahdr.nblocks == arc_index_cap) {
+        arc_index_cap = arc_index_cap ? arc_index_cap * 2 : 64;
+        arc_index = intern_alloc(arc_index, arc_index_cap * sizeof *arc_index);
     }
+    arc_index[ahdr.nblocks++] = arc_cur;
+    memset(&arc_cur, 0, sizeof arc_cur);
+    arc_ids.len = arc_lines.len = 0;
 }
 
-int main(int argc, char **argv) {
-    const char *infile = NULL;
-    if (argc > 1) infile = argv[1];
-    in  = infile ? fopen(infile, "r") : stdin;
-    if (!in) { fprintf(stderr, "Failed to open input file.\n"); return 1; }
-    out = fopen("tokens.txt", "w");
-    if (!out) { fprintf(stderr, "Failed to open tokens.txt for writing.\n"); return 1; }
-
-    fprintf(out, "Token\tLexeme\tLine No\n");
-
-    for (;;) {
-        skip_ws_and_comments();
-        int c = getc_track();
-        if (c == EOF) break;
-
-        if (is_ident_start(c)) {
-            char buf[256]; int i=0;
-            buf[i++]=(char)c;
-            for (;;) {
-                int d = getc_track();
-                if (!is_ident_part(d)) { ungetc_track(d); break; }
-                if (i < (int)sizeof(buf)-1) buf[i++]=(char)d;
-            }
-            buf[i]=0;
-            const char *tk = keyword_or_ident(buf);
-            emit(tk, buf, line_no);
-            continue;
+static void arc_put(const token_t *t, const char *text) {
+    if (arc_cur.count == 0) arc_cur.first_line = arc_prev_line = t->line;
+    const char *nul = memchr(text, 0, t->len);     /* lexemes are C strings to the readers */
+    uint32_t id = intern(&lexdict, text, nul ? (size_t)(nul - text) : t->len);
+    int64_t d = (int64_t)t->line - arc_prev_line;
+    arc_prev_line = t->line;
+    arc_kinds[arc_cur.count++] = (unsigned char)t->kind;
+    put_varint(&arc_ids, id);
+    put_varint(&arc_lines, ((uint64_t)d << 1) ^ (uint64_t)(d >> 63));
+    ahdr.ntok++;
+    if (arc_cur.count == TOKARC_BLOCK) arc_flush_block();
+}
+
+static int tokarc_create(const char *path) {
+    arc = fopen(path, "wb");
+    if (!arc) return 0;
+    static char vbuf[1 << 16];
+    setvbuf(arc, vbuf, _IOFBF, sizeof vbuf);
+    fwrite(&ahdr, sizeof ahdr, 1, arc);
+    arc_off = sizeof ahdr;
+    return 1;
+}
+
+static int tokarc_finish(void) {
+    static const char zero[8];
+    arc_flush_block();
+    memcpy(ahdr.magic, TOKARC_MAGIC, sizeof ahdr.magic);
+    ahdr.version = TOKARC_VERSION;
+    ahdr.byte_order = TOKFILE_BYTE_ORDER;
+    ahdr.block_tokens = TOKARC_BLOCK;
+    ahdr.nkinds = TK_NKINDS;
+    ahdr.nlex = lexdict.count;
+    ahdr.index = (arc_off + 7) & ~(uint64_t)7;
+    fwrite(zero, 1, ahdr.index - arc_off, arc);
+    fwrite(arc_index, sizeof *arc_index, ahdr.nblocks, arc);
+    ahdr.dict = ahdr.index + ahdr.nblocks * sizeof *arc_index;
+    for (uint32_t i = 0; i <= lexdict.count; i++) {
+        uint64_t off = i < lexdict.count ? lexdict.off[i] : lexdict.pool_len;
+        fwrite(&off, sizeof off, 1, arc);
+    }
+    ahdr.pool = ahdr.dict + (ahdr.nlex + 1) * sizeof(uint64_t);
+    ahdr.pool_len = lexdict.pool_len;
+    fwrite(lexdict.pool, 1, lexdict.pool_len, arc);
+    ahdr.kinds = ahdr.pool + ahdr.pool_len;
+    for (int k = 0; k < TK_NKINDS; k++) {
+        size_t n = strlen(tok_kind_name[k]) + 1;
+        fwrite(tok_kind_name[k], 1, n, arc);
+        ahdr.kinds_len += n;
+    }
+    fseek(arc, 0, SEEK_SET);
+    fwrite(&ahdr, sizeof ahdr, 1, arc);
+    int ok = !ferror(arc);
+    if (fclose(arc) != 0) ok = 0;
+    arc = NULL;
+    free(arc_ids.data);
+    free(arc_lines.data);
+    memset(&arc_ids, 0, sizeof arc_ids);
+    memset(&arc_lines, 0, sizeof arc_lines);
+    free(arc_index);
+    arc_index = NULL;
+    arc_index_cap = 0;
+    intern_free(&lexdict);
+    return ok;
+}
+
+/* ---------- token rings (tarjuman driver) ----------
+   Every token goes to each ring, one per analyser. Identifier names are
+   copied once into chunks that never move, as the analysers' symbol
+   tables keep them after the ring has moved on. */
+
+#define NAME_CHUNK (1 << 16)
+
+static TokRing **rings;
+static int nrings;
+static const char **ring_name;  /* id -> lasting copy of the name */
+static size_t ring_name_cap;
+static char *name_chunk;
+static size_t name_chunk_left;
+
+static const char *lasting_name(int id, const char *text, size_t len) {
+    if ((size_t)id >= ring_name_cap) {
+        size_t cap = ring_name_cap ? ring_name_cap : 1024;
+        while (cap <= (size_t)id) cap *= 2;
+        ring_name = intern_alloc(ring_name, cap * sizeof *ring_name);
+        memset(ring_name + ring_name_cap, 0, (cap - ring_name_cap) * sizeof *ring_name);
+        ring_name_cap = cap;
+    }
+    if (!ring_name[id]) {
+        if (name_chunk_left < len + 1) {
+            name_chunk_left = len + 1 > NAME_CHUNK ? len + 1 : NAME_CHUNK;
+            name_chunk = intern_alloc(NULL, name_chunk_left);
         }
+        memcpy(name_chunk, text, len);
+        name_chunk[len] = 0;
+        ring_name[id] = name_chunk;
+        name_chunk += len + 1;
+        name_chunk_left -= len + 1;
+    }
+    return ring_name[id];
+}
+
+static void ring_put(const token_t *t, const char *text) {
+    Tok r = { NULL, t->line, -1, t->kind, 0, 0, TOKEN_BEGIN(t) };
+    if (t->kind == TK_IDENTIFIER) {
+        r.id = t->id >= 0 ? t->id : (int)intern(&names, text, t->len);
+        r.lexeme = lasting_name(r.id, text, t->len);
+    } else if (t->kind == TK_INT_CONST) {
+        r.value = t->value;
+        r.out_of_range = t->out_of_range;
+    }
+    for (int k = 0; k < nrings; k++) tokring_put(rings[k], &r, text, t->len);
+}
+
+/* Write one token to every output; its lexeme is text[0, t->len), and lit
+   the literal pool it was decoded into */
+static void put_token(const token_t *t, const char *text, const char *lit) {
+    if (out.fd >= 0) {
+        const char *nul = memchr(text, 0, t->len);     /* the lexeme column stops at a NUL */
+        out_str(&out, tok_kind_name[t->kind]);
+        out_char(&out, '\t');
+        out_bytes(&out, text, nul ? (size_t)(nul - text) : t->len);
+        out_char(&out, '\t');
+        out_int(&out, t->line);
+        out_char(&out, '\n');
+    }
+    if (bin || bin_keep) bin_put(t, text, lit);
+    if (arc) arc_put(t, text);
+    if (nrings) ring_put(t, text);
+}
 
-        if (isdigit(c)) {
-            char buf[256]; int i=0;
-            buf[i++]=(char)c;
-            for (;;) {
-                int d = getc_track();
-                if (!isdigit(d)) { ungetc_track(d); break; }
-                if (i < (int)sizeof(buf)-1) buf[i++]=(char)d;
-            }
-            buf[i]=0;
-            emit("INT_CONST", buf, line_no);
-            continue;
+/* Write every token of lx. Decoded constants are dropped once their
+   batch is out. */
+static void write_tokens(lexer_t *lx) {
+    token_t t;
+    while (lexer_next(lx, &t)) {
+        put_token(&t, lexer_text(lx, &t), lx->literals ? lx->literals->data : NULL);
+        if (lx->literals && !lx->count) lx->literals->len = 0;
+    }
+}
+
+/* ---------- Parallel chunked lexing (mmapped input) ----------
+   The source is cut into one chunk per thread, each ending just after a
+   newline. Only a block comment can be open across a newline (strings,
+   char constants and error skips all stop at one), so every chunk is
+   lexed speculatively as if it starts at a token boundary. Stitching
+   walks the chunks in order; a chunk whose predecessor left a comment
+   open is re-lexed starting inside that comment. Line numbers come from a
+   newline count per chunk taken before lexing. Chunks keep their token
+   spans; only the writing is sequential. */
+
+typedef struct {
+    const unsigned char *src;
+    const unsigned char *begin, *end;
+    int base_line;
+    int use_index, caret;
+    int literals;       /* decode constants into lits */
+    LineTable lines;
+    TokList toks;
+    TextBuf lits;
+    TextBuf errs;
+    int in_comment;     /* start line of a comment open at begin, else 0 */
+    size_t comment_off; /* in_comment: the comment's offset */
+    int open_comment;   /* start line of a comment left open at the end, else 0 */
+    size_t open_comment_off;
+} Chunk;
+
+static void *count_chunk_lines(void *arg) {
+    Chunk *c = arg;
+    int n = 0;
+    for (const unsigned char *p = c->begin; p < c->end; p++) {
+        p = memchr(p, '\n', (size_t)(c->end - p));
+        if (!p) break;
+        n++;
+    }
+    c->base_line = n;
+    return NULL;
+}
+
+/* Each chunk gets its own lexer; tokens and diagnostics go to its buffers */
+static void lex_chunk_body(Chunk *c) {
+    lexer_t *lx = lexer_open_mem(c->src, (size_t)(c->begin - c->src), (size_t)(c->end - c->src), c->base_line);
+    if (!lx) { fprintf(stderr, "Out of memory\n"); exit(1); }
+    lx->use_index = c->use_index;
+    lx->partial = 1;
+    lx->in_comment = c->in_comment;
+    if (c->in_comment) lx->comment_off = c->comment_off;
+    if (c->caret) { c->lines.n = 0; lx->lines = &c->lines; lx->caret = 1; }
+    if (c->literals) lx->literals = &c->lits;
+    lx->on_error = lex_error_to_buf;
+    lx->error_ctx = &c->errs;
+    while (!lx->done) {
+        lex_refill(lx);
+        take_spans(&c->toks, lx);
+    }
+    c->open_comment = lx->open_comment;
+    c->open_comment_off = lx->comment_off;
+    lexer_close(lx);
+    free(c->lines.start);
+    c->lines.start = NULL; c->lines.cap = 0;
+}
+
+static void *lex_chunk(void *arg) {
+    lex_chunk_body(arg);
+    return NULL;
+}
+
+static int run_chunks(Chunk *c, int n, void *(*fn)(void *)) {
+    pthread_t *tid = malloc((size_t)n * sizeof *tid);
+    if (!tid) return 0;
+    int started = 0;
+    for (; started < n; started++)
+        if (pthread_create(&tid[started], NULL, fn, &c[started]) != 0) break;
+    for (int i = started; i < n; i++) fn(&c[i]);   /* no more threads: run inline */
+    for (int i = 0; i < started; i++) pthread_join(tid[i], NULL);
+    free(tid);
+    return 1;
+}
+
+static void lex_parallel(lexer_t *lx, int jobs, int use_index) {
+    Chunk *c = calloc((size_t)jobs, sizeof *c);
+    if (!c) { lx->use_index = use_index; write_tokens(lx); return; }
+    int caret = lx->caret, literals = lx->literals != NULL;
+
+    int n = 0;
+    const unsigned char *p = lx->src, *lim = lx->lim;
+    while (p < lim && n < jobs) {
+        const unsigned char *e = (n == jobs - 1) ? lim : p + (size_t)(lim - p) / (size_t)(jobs - n);
+        if (e < lim) {
+            const unsigned char *nl = memchr(e, '\n', (size_t)(lim - e));
+            e = nl ? nl + 1 : lim;
         }
+        c[n].src = lx->src; c[n].begin = p; c[n].end = e; c[n].use_index = use_index; c[n].caret = caret;
+        c[n].literals = literals;
+        n++;
+        p = e;
+    }
 
-        if (c == '"') { scan_string(); continue; }
-        if (c == '\''){ scan_char(); continue; }
+    run_chunks(c, n, count_chunk_lines);
+    int line = 1;
+    for (int i = 0; i < n; i++) {
+        int lines = c[i].base_line;
+        c[i].base_line = line;
+        line += lines;
+    }
+    run_chunks(c, n, lex_chunk);
 
-        if (c == '=') {
-            int d = getc_track();
-            if (d == '=') emit("EQ", "==", line_no);
-            else { ungetc_track(d); emit("ASSIGN", "=", line_no); }
-            continue;
+    int comment_line = 0;   /* non-zero while a comment is open */
+    size_t comment_off = 0;
+    for (int i = 0; i < n; i++) {
+        if (comment_line) {
+            /* speculation failed: this chunk starts inside a comment */
+            c[i].toks.n = c[i].errs.len = c[i].lits.len = 0;
+            c[i].in_comment = comment_line;
+            c[i].comment_off = comment_off;
+            lex_chunk_body(&c[i]);
         }
-        if (c == '+') { emit("PLUS", "+", line_no); continue; }
-        if (c == '-') { emit("MINUS","-", line_no); continue; }
-        if (c == '*') { emit("STAR", "*", line_no); continue; }
-        if (c == '/') { emit("SLASH","/", line_no); continue; }
-        if (c == '>') { emit("GT", ">", line_no); continue; }
-        if (c == '<') { emit("LT", "<", line_no); continue; }
-
-        if (c == '(') { emit("LPAREN","(", line_no); continue; }
-        if (c == ')') { emit("RPAREN",")", line_no); continue; }
-        if (c == '{') { emit("LBRACE","{", line_no); continue; }
-        if (c == '}') { emit("RBRACE","}", line_no); continue; }
-        if (c == '[') { emit("LBRACKET","[", line_no); continue; }
-        if (c == ']') { emit("RBRACKET","]", line_no); continue; }
-        if (c == ';') { emit("SEMICOLON",";", line_no); continue; }
-        if (c == ',') { emit("COMMA",",", line_no); continue; }
-
-        fprintf(stderr, "Line %d: Undefined symbol\n", line_no);
-        skip_line_after_error();
-    }
-
-    fclose(out);
-    if (in && in != stdin) fclose(in);
+        comment_line = c[i].open_comment;
+        comment_off = c[i].open_comment_off;
+        for (size_t k = 0; k < c[i].toks.n; k++)
+            put_token(&c[i].toks.v[k], (const char *)lx->src + c[i].toks.v[k].off, c[i].lits.data);
+        if (c[i].errs.len) fwrite(c[i].errs.data, 1, c[i].errs.len, stderr);
+        free(c[i].toks.v);
+        free(c[i].errs.data);
+        free(c[i].lits.data);
+    }
+    if (comment_line) {
+        /* the chunks have lexed all of lx: report through it, so --caret
+           quotes the comment's line as sequential lexing does */
+        lx->cur = lx->lim;
+        lex_error(lx, comment_line, comment_off, "Un-terminated comments");
+    }
+    free(c);
+}
+
+/* --edit: lex the input, apply one edit in memory and re-lex only what
+   it disturbs. The token files get the edited stream, stdout the range. */
+static int lex_edit(lexer_t *lx, LexEdit *e) {
+    if (lx->win || !lx->src_len) { fprintf(stderr, "--edit needs a regular, non-empty input file.\n"); return 1; }
+    const unsigned char *src = lx->src;
+    size_t src_len = lx->src_len;
+    if (e->off > src_len || e->removed > src_len - e->off) { fprintf(stderr, "Edit is outside the input.\n"); return 1; }
+    size_t n = src_len - e->removed + e->inserted;
+    unsigned char *s = malloc(n + 1);
+    if (!s) { fprintf(stderr, "Out of memory\n"); return 1; }
+    memcpy(s, src, e->off);
+    memcpy(s + e->off, e->text, e->inserted);
+    memcpy(s + e->off + e->inserted, src + e->off + e->removed, src_len - e->off - e->removed);
+
+    TokList l = { NULL, 0, 0, NULL, { NULL, 0, 0 }, NULL, lx->literals };
+    TokRange r;
+    lex_collect(&l, src, src_len);
+    relex(&l, s, n, e, &r);
+    if (l.errs.len) fwrite(l.errs.data, 1, l.errs.len, stderr);
+
+    for (size_t i = 0; i < l.n; i++) put_token(&l.v[i], (const char *)s + l.v[i].off, lits.data);
+    printf("Tokens %zu..%zu re-lexed, replacing %zu\n", r.first, r.first + r.new_count, r.old_count);
+
+    free(l.v);
+    free(l.errs.data);
+    free(s);
     return 0;
-}
\ No newline at end of file
+}
+
+int lexical_run(int argc, char **argv, TokFile *tokens) {
+    const char *infile = NULL;
+    int use_index = 0, jobs = 1, edit = 0, caret = 0, text = 0, archive = 0;
+    LexEdit e = { 0, 0, "", 0 };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--index") == 0) use_index = 1;
+        else if (strcmp(argv[i], "--caret") == 0) caret = 1;
+        else if (strcmp(argv[i], "--text") == 0) text = 1;
+        else if (strcmp(argv[i], "--archive") == 0) archive = 1;
+        else if (strcmp(argv[i], "--edit") == 0 && i + 3 < argc) {
+            /* --edit OFFSET REMOVED TEXT */
+            e.off = strtoul(argv[++i], NULL, 10);
+            e.removed = strtoul(argv[++i], NULL, 10);
+            e.text = argv[++i];
+            e.inserted = strlen(e.text);
+            edit = 1;
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) jobs = atoi(argv[++i]);
+        else infile = argv[i];
+    }
+    /* the compile server's children start from its warm-up run: start
+       from empty writers, keeping their buffers */
+    memset(&hdr, 0, sizeof hdr);
+    memset(&ahdr, 0, sizeof ahdr);
+    pool.len = recs.len = lits.len = 0;
+    bin_keep = 0;
+
+    lexer_t *lx = source ? lexer_open_mem(source, 0, source_len, 1) : lexer_open(infile);
+    if (!lx) { fprintf(stderr, "Failed to open input file.\n"); return 1; }
+    /* in the driver the tokens stay in memory or stream to the analysers;
+       --archive: tokens.tka replaces tokens.bin, which the analysers would read first */
+    if (tokens) { bin_keep = 1; pool_add("", 0); }
+    else if (archive && !nrings) {
+        if (!tokarc_create("tokens.tka")) { fprintf(stderr, "Failed to open tokens.tka for writing.\n"); return 1; }
+        remove("tokens.bin");
+    }
+    else if (!nrings && !tokbin_open("tokens.bin")) { fprintf(stderr, "Failed to open tokens.bin for writing.\n"); return 1; }
+    /* --text: also export the tokens as tokens.txt */
+    if (text) {
+        if (!out_open(&out, "tokens.txt")) { fprintf(stderr, "Failed to open tokens.txt for writing.\n"); return 1; }
+        out_str(&out, "Token\tLexeme\tLine No\n");
+    }
+
+    /* --caret: diagnostics quote the source line, located via the line table */
+    LineTable lines = { NULL, 0, 0, 0, 0 };
+    if (caret) { lx->lines = &lines; lx->caret = 1; }
+    if (bin || bin_keep || nrings) lx->names = &names;
+    if (bin || bin_keep) lx->literals = &lits;
+
+    /* the index and chunking need the whole source; streamed input lexes sequentially */
+    int rc = 0;
+    if (edit) rc = lex_edit(lx, &e);
+    else if (jobs > 1 && !lx->win) lex_parallel(lx, jobs, use_index);
+    else { lx->use_index = use_index; write_tokens(lx); }
+
+    if (out.fd >= 0 && !out_close(&out)) { fprintf(stderr, "Failed to write tokens.txt.\n"); rc = 1; }
+    if (bin && !tokbin_close()) { fprintf(stderr, "Failed to write tokens.bin.\n"); rc = 1; }
+    if (arc && !tokarc_finish()) { fprintf(stderr, "Failed to write tokens.tka.\n"); rc = 1; }
+    if (bin_keep) tokbin_hand_over(tokens);
+    lexer_close(lx);
+    free(lines.start);
+    return rc;
+}
+
+int lexical_run_buffer(int argc, char **argv, const unsigned char *src, size_t len, TokFile *tokens) {
+    source = src;
+    source_len = len;
+    int rc = lexical_run(argc, argv, tokens);
+    source = NULL;
+    return rc;
+}
+
+int lexical_stream(int argc, char **argv, TokRing **to, int n) {
+    rings = to;
+    nrings = n;
+    int rc = lexical_run(argc, argv, NULL);
+    for (int k = 0; k < n; k++) tokring_close(to[k], rc != 0);
+    return rc;
+}
+
+#ifndef TARJUMAN
+int main(int argc, char **argv) {
+    return lexical_run(argc, argv, NULL);
+}
+#endif
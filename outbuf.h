@@ -0,0 +1,116 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+/* Buffered text output for tokens.txt and the symbol tables. Rows are
+   assembled in a large user-space buffer, numbers formatted by hand, and
+   the buffer goes to the file in big writes; a piece too large for the
+   buffer goes out together with it in one writev(). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#ifndef OUT_BUF_SIZE
+#define OUT_BUF_SIZE (1 << 18)
+#endif
+
+typedef struct {
+    int fd;
+    int failed;             /* a write failed; later output is dropped */
+    size_t len;
+    char *buf;              /* OUT_BUF_SIZE bytes */
+} OutBuf;
+
+/* Create or truncate path for writing. 1 on success. */
+static inline int out_open(OutBuf *o, const char *path) {
+    o->failed = 0;
+    o->len = 0;
+    o->buf = NULL;
+    o->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (o->fd < 0) return 0;
+    o->buf = malloc(OUT_BUF_SIZE);
+    if (!o->buf) { close(o->fd); o->fd = -1; return 0; }
+    return 1;
+}
+
+/* Write the buffered bytes, then n bytes at p */
+static void out_flush_with(OutBuf *o, const char *p, size_t n) {
+#ifndef _WIN32
+    struct iovec v[2] = { { o->buf, o->len }, { (void *)p, n } }, *iv = v;
+    int cnt = 2;
+    while (!o->failed) {
+        while (cnt && iv->iov_len == 0) { iv++; cnt--; }
+        if (!cnt) break;
+        ssize_t w = writev(o->fd, iv, cnt);
+        if (w <= 0) {
+            if (w == 0 || errno != EINTR) o->failed = 1;
+            continue;
+        }
+        for (size_t k; w > 0; w -= (ssize_t)k) {       /* step past what went out */
+            k = (size_t)w < iv->iov_len ? (size_t)w : iv->iov_len;
+            iv->iov_base = (char *)iv->iov_base + k;
+            iv->iov_len -= k;
+            if (!iv->iov_len) { iv++; cnt--; }
+        }
+    }
+#else
+    const char *part[2] = { o->buf, p };
+    size_t left[2] = { o->len, n };
+    for (int i = 0; i < 2 && !o->failed; i++)
+        while (left[i] && !o->failed) {
+            int w = write(o->fd, part[i], (unsigned)(left[i] < (1u << 30) ? left[i] : (1u << 30)));
+            if (w <= 0) o->failed = 1;
+            else { part[i] += w; left[i] -= (size_t)w; }
+        }
+#endif
+    o->len = 0;
+}
+
+static inline void out_bytes(OutBuf *o, const char *p, size_t n) {
+    if (OUT_BUF_SIZE - o->len < n) {
+        if (n >= OUT_BUF_SIZE) { out_flush_with(o, p, n); return; }
+        out_flush_with(o, NULL, 0);
+    }
+    memcpy(o->buf + o->len, p, n);
+    o->len += n;
+}
+
+static inline void out_str(OutBuf *o, const char *s) {
+    out_bytes(o, s, strlen(s));
+}
+
+static inline void out_char(OutBuf *o, char c) {
+    if (o->len == OUT_BUF_SIZE) out_flush_with(o, NULL, 0);
+    o->buf[o->len++] = c;
+}
+
+/* Decimal, as printf's %d would write it */
+static inline void out_int(OutBuf *o, long long v) {
+    char tmp[24], *e = tmp + sizeof tmp, *p = e;
+    unsigned long long u = v < 0 ? 0 - (unsigned long long)v : (unsigned long long)v;
+    do *--p = (char)('0' + u % 10); while (u /= 10);
+    if (v < 0) *--p = '-';
+    out_bytes(o, p, (size_t)(e - p));
+}
+
+/* Flush and close. 1 if everything was written. */
+static inline int out_close(OutBuf *o) {
+    if (o->fd < 0) return 0;
+    out_flush_with(o, NULL, 0);
+    int ok = !o->failed;
+    if (close(o->fd) != 0) ok = 0;
+    free(o->buf);
+    o->buf = NULL;
+    o->fd = -1;
+    return ok;
+}
+
+#endif /* OUTBUF_H */
@@ -2,32 +2,37 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* ---------- Token & Symbol Definitions ---------- */
+#include "tokread.h"
+#include "outbuf.h"
+#include "tarjuman.h"
 
-typedef struct {
-    char token[32];
-    char lexeme[256];
-    int  line;
-} Tok;
+/* ---------- Symbol Definitions ---------- */
 
-#define MAXTOK 100000
-static Tok toks[MAXTOK];
-static int ntok = 0;
-static int pos  = 0;
+#define NO_SYM SIZE_MAX     /* ends a name's chain */
 
 typedef struct {
-    char lexeme[128];
+    const char *lexeme; /* the name token's, which outlives the table */
     char type[32];
     char scope[64];
     int  array_size;
+    size_t next;        /* next symbol with the same name id, or NO_SYM */
 } Sym;
 
-#define MAXSYM 4096
-static Sym symtab[MAXSYM];
-static int nsym = 0;
+static Store symtab = { .elem = sizeof(Sym) };
+static size_t nsym = 0;
+
+static Sym *sym_at(size_t i) { return store_at(&symtab, i); }
+
+/* Identifiers are compared by name id: the lexer's or the archive's, or
+   interned here from tokens.txt. sym_of_id[id] heads the chain of
+   symbols declared under that name. */
+static InternTable names;
+static size_t *sym_of_id;
+static size_t nchains;
 
 static char cur_scope[64] = "Global";
 static int error_count = 0;
+static FILE *out_to, *err_to;   /* stdout and stderr, unless the driver defers them */
 
 /* internal type codes */
 #define TYPE_ERROR 0
@@ -37,57 +42,33 @@ static int error_count = 0;
 /* ---------- Utility / Error Functions ---------- */
 
 static void semantic_error(const char *msg, int line) {
-    fprintf(stderr, "Line %d: %s\n", line, msg);
+    fprintf(err_to, "Line %d: %s\n", line, msg);
     error_count++;
 }
 
 /* syntax error helper (we still keep minimal syntax checks) */
 static void syn_error(const char *msg) {
-    Tok t = (pos < ntok) ? toks[pos] : (Tok){"EOF", "", 999999};
-    fprintf(stderr, "Line %d: %s\n", t.line, msg);
+    const Tok *t = LA();
+    fprintf(err_to, "Line %d: %s\n", t->line, msg);
     error_count++;
-    int cur = t.line;
-    while (pos < ntok && toks[pos].line == cur) pos++;
-}
-
-/* ---------- Token Helpers ---------- */
-
-static Tok LA(void) {
-    if (pos < ntok) return toks[pos];
-    Tok eof = {"EOF", "", 999999};
-    return eof;
+    skip_line_tokens(t->line);
 }
 
-static Tok consume(void) {
-    if (pos < ntok) return toks[pos++];
-    Tok eof = {"EOF", "", 999999};
-    return eof;
-}
-
-static int match(const char *tk, Tok *out) {
-    Tok a = LA();
-    if (strcmp(a.token, tk) == 0) {
-        if (out) *out = a;
-        consume();
-        return 1;
-    }
-    return 0;
-}
+static const Tok no_name = {"", 0, -1, TK_UNKNOWN, 0, 0, SIZE_MAX};   /* stands in for a missing name */
 
 /* ---------- Symbol Table / Type Helpers ---------- */
 
-static Sym* lookup_symbol(const char *name) {
+static Sym* lookup_symbol(int id) {
+    if (id < 0 || (size_t)id >= nchains) return NULL;
     /* current scope first */
-    for (int i = 0; i < nsym; ++i) {
-        if (strcmp(symtab[i].lexeme, name) == 0 &&
-            strcmp(symtab[i].scope,  cur_scope) == 0)
-            return &symtab[i];
+    for (size_t i = sym_of_id[id]; i != NO_SYM; i = sym_at(i)->next) {
+        if (strcmp(sym_at(i)->scope, cur_scope) == 0)
+            return sym_at(i);
     }
     /* then Global */
-    for (int i = 0; i < nsym; ++i) {
-        if (strcmp(symtab[i].lexeme, name) == 0 &&
-            strcmp(symtab[i].scope,  "Global") == 0)
-            return &symtab[i];
+    for (size_t i = sym_of_id[id]; i != NO_SYM; i = sym_at(i)->next) {
+        if (strcmp(sym_at(i)->scope, "Global") == 0)
+            return sym_at(i);
     }
     return NULL;
 }
@@ -99,34 +80,41 @@ static int str_to_type(const char *t) {
 }
 
 static int const_token_type(const Tok *t) {
-    if (strcmp(t->token, "INT_CONST")  == 0) return TYPE_INT;
-    if (strcmp(t->token, "CHAR_CONST") == 0) return TYPE_CHAR;
-    return TYPE_ERROR;
+    switch (t->kind) {
+    case TK_INT_CONST:  return TYPE_INT;
+    case TK_CHAR_CONST: return TYPE_CHAR;
+    default:            return TYPE_ERROR;
+    }
 }
 
-static void add_symbol(const char *name, const char *type, const char *scope, int arrsz) {
-    if (nsym >= MAXSYM) return;
+static int alloc_sym_chains(size_t count);
 
+static void add_symbol(const Tok *name, const char *type, const char *scope, int arrsz) {
     /* Multiple declarations in same scope */
-    for (int i = 0; i < nsym; ++i) {
-        if (strcmp(symtab[i].lexeme, name) == 0 &&
-            strcmp(symtab[i].scope,  scope) == 0) {
-            int line = (pos > 0) ? toks[pos-1].line : 0;
+    size_t head = name->id >= 0 && (size_t)name->id < nchains ? sym_of_id[name->id] : NO_SYM;
+    for (size_t i = head; i != NO_SYM; i = sym_at(i)->next) {
+        if (strcmp(sym_at(i)->scope, scope) == 0) {
+            int line = (pos > 0) ? tok_get(pos-1)->line : 0;
             semantic_error("Multiple declarations of same identifier.", line);
             return;
         }
     }
 
-    snprintf(symtab[nsym].lexeme, sizeof(symtab[nsym].lexeme), "%s", name);
-    snprintf(symtab[nsym].type,   sizeof(symtab[nsym].type),   "%s", type);
-    snprintf(symtab[nsym].scope,  sizeof(symtab[nsym].scope),  "%s", scope);
-    symtab[nsym].array_size = arrsz;
+    Sym *s = store_push(&symtab);
+    s->lexeme = name->lexeme;
+    snprintf(s->type,   sizeof(s->type),   "%s", type);
+    snprintf(s->scope,  sizeof(s->scope),  "%s", scope);
+    s->array_size = arrsz;
+    s->next = head;
+    if (name->id >= 0) {
+        if (!alloc_sym_chains((size_t)name->id + 1)) exit(1);
+        sym_of_id[name->id] = nsym;
+    }
     nsym++;
 }
 
 /* ---------- Grammar Prototypes ---------- */
 
-static void program(void);
 static int  type_specifier(char *out);
 static void global_decl_list(void);
 static void declaration(const char *typestr);
@@ -143,19 +131,21 @@ static void if_stmt(void);
 static void while_stmt(void);
 static void for_stmt(void);
 static int  expression_if_any(int *out_type);
-static int  is_operator(const char *tk);
+static int  is_operator(TokKind tk);
 
 /* ---------- Small Helpers ---------- */
 
-static int is_type_token(const char *tk) {
-    return strcmp(tk,"VOID")==0 || strcmp(tk,"CHAR")==0 || strcmp(tk,"INT")==0;
+static int is_type_token(TokKind tk) {
+    return tk == TK_VOID || tk == TK_CHAR || tk == TK_INT;
 }
 
-static const char* norm_type_token(const char *tk) {
-    if (strcmp(tk,"VOID")==0) return "Void";
-    if (strcmp(tk,"CHAR")==0) return "Char";
-    if (strcmp(tk,"INT")==0)  return "Int";
-    return "?";
+static const char* norm_type_token(TokKind tk) {
+    switch (tk) {
+    case TK_VOID: return "Void";
+    case TK_CHAR: return "Char";
+    case TK_INT:  return "Int";
+    default:      return "?";
+    }
 }
 
 /* ---------- Grammar Implementation (with semantics) ---------- */
@@ -171,14 +161,10 @@ static void program(void) {
 /* global_decl_list: { type_specifier (NOT MAIN) declaration } */
 static void global_decl_list(void) {
     for (;;) {
-        Tok t = LA();
-        if (!is_type_token(t.token)) return;
+        if (!is_type_token(peek())) return;
 
         /* lookahead to see if this is function_def */
-        consume();
-        Tok t2 = LA();
-        pos--;
-        if (strcmp(t2.token, "MAIN") == 0) {
+        if (peek2() == TK_MAIN) {
             return; /* function_def starts here */
         }
 
@@ -190,9 +176,9 @@ static void global_decl_list(void) {
 
 /* type_specifier: VOID | CHAR | INT */
 static int type_specifier(char *out) {
-    Tok t = LA();
-    if (!is_type_token(t.token)) return 0;
-    strcpy(out, norm_type_token(t.token));
+    TokKind k = peek();
+    if (!is_type_token(k)) return 0;
+    strcpy(out, norm_type_token(k));
     consume();
     return 1;
 }
@@ -200,44 +186,48 @@ static int type_specifier(char *out) {
 /* declaration: type_specifier init_declarator_list ';' */
 static void declaration(const char *typestr) {
     init_declarator_list(typestr);
-    if (!match("SEMICOLON", NULL)) syn_error("Semicolon expected");
+    if (!match(TK_SEMICOLON, NULL)) syn_error("Semicolon expected");
 }
 
 /* init_declarator_list: init_declarator { ',' init_declarator } */
 static void init_declarator_list(const char *typestr) {
     init_declarator(typestr);
-    while (match("COMMA", NULL)) {
+    while (match(TK_COMMA, NULL)) {
         init_declarator(typestr);
     }
 }
 
 /* init_declarator: IDENTIFIER array_opt init_opt */
 static void init_declarator(const char *typestr) {
-    Tok id;
-    if (!match("IDENTIFIER", &id)) { syn_error("Identifier expected"); return; }
+    const Tok *id;
+    if (!match(TK_IDENTIFIER, &id)) { syn_error("Identifier expected"); return; }
+    Tok name = *id;     /* error recovery may skip past id's ring batch */
 
     int arrsz = 0;
     array_opt(&arrsz);
     init_opt();
-    add_symbol(id.lexeme, typestr, cur_scope, arrsz);
+    add_symbol(&name, typestr, cur_scope, arrsz);
 }
 
 /* array_opt: empty | '[' INT_CONST ']' */
 static int array_opt(int *size_out) {
-    if (!match("LBRACKET", NULL)) return 0;
+    if (!match(TK_LBRACKET, NULL)) return 0;
     int size = 0;
-    Tok num;
-    if (match("INT_CONST", &num)) size = atoi(num.lexeme);
-    if (!match("RBRACKET", NULL)) syn_error("Right bracket expected");
+    const Tok *num;
+    if (match(TK_INT_CONST, &num)) {
+        if (num->out_of_range) semantic_error("Array size out of range.", num->line);
+        else size = num->value;
+    }
+    if (!match(TK_RBRACKET, NULL)) syn_error("Right bracket expected");
     if (size_out) *size_out = size;
     return 1;
 }
 
 /* init_opt: empty | '=' (INT_CONST | CHAR_CONST) */
 static int init_opt(void) {
-    if (!match("ASSIGN", NULL)) return 0;
-    Tok t = LA();
-    if (strcmp(t.token,"INT_CONST")==0 || strcmp(t.token,"CHAR_CONST")==0) {
+    if (!match(TK_ASSIGN, NULL)) return 0;
+    TokKind k = peek();
+    if (k == TK_INT_CONST || k == TK_CHAR_CONST) {
         consume();
         return 1;
     }
@@ -249,315 +239,317 @@ static int init_opt(void) {
 static void function_def(const char *ret_type) {
     (void)ret_type; /* not used in this phase */
 
-    if (!match("MAIN", NULL)) { syn_error("MAIN expected"); return; }
-    if (!match("LPAREN", NULL)) syn_error("Opening parenthesis missing");
+    if (!match(TK_MAIN, NULL)) { syn_error("MAIN expected"); return; }
+    if (!match(TK_LPAREN, NULL)) syn_error("Opening parenthesis missing");
 
     /* parameters: either VOID, or (type IDENTIFIER {, type IDENTIFIER}) */
-    Tok t = LA();
-    if (strcmp(t.token,"VOID")==0) {
+    if (peek() == TK_VOID) {
         consume();
     } else {
         for (;;) {
             char pty[16];
             if (!type_specifier(pty)) syn_error("Any keyword expected");
-            Tok pid;
-            if (!match("IDENTIFIER", &pid)) syn_error("Identifier expected");
-            add_symbol(pid.lexeme, pty, "Main", 0);
-            if (!match("COMMA", NULL)) break;
+            const Tok *pid = &no_name;
+            if (!match(TK_IDENTIFIER, &pid)) syn_error("Identifier expected");
+            add_symbol(pid, pty, "Main", 0);
+            if (!match(TK_COMMA, NULL)) break;
         }
     }
 
-    if (!match("RPAREN", NULL)) syn_error("Closing parenthesis missing");
-    if (!match("LBRACE", NULL)) syn_error("{ missing");
+    if (!match(TK_RPAREN, NULL)) syn_error("Closing parenthesis missing");
+    if (!match(TK_LBRACE, NULL)) syn_error("{ missing");
 
     strcpy(cur_scope, "Main");
     stmt_list_opt();
-    if (!match("RBRACE", NULL)) syn_error("} missing");
+    if (!match(TK_RBRACE, NULL)) syn_error("} missing");
     strcpy(cur_scope, "Global");
 }
 
 /* stmt_list_opt: { statement } */
 static void stmt_list_opt(void) {
     for (;;) {
-        Tok t = LA();
-        if (strcmp(t.token,"RBRACE")==0 || strcmp(t.token,"EOF")==0) return;
+        TokKind k = peek();
+        if (k == TK_RBRACE || k == TK_EOF) return;
         statement();
     }
 }
 
 /* statement: declaration | expr_stmt | if_stmt | while_stmt | for_stmt | block */
 static void statement(void) {
-    Tok t = LA();
-    if (is_type_token(t.token)) {
+    switch (peek()) {
+    case TK_VOID: case TK_CHAR: case TK_INT: {
         char typestr[16];
         if (!type_specifier(typestr)) { syn_error("Any keyword expected"); return; }
         declaration(typestr);
-    } else if (strcmp(t.token,"IF")==0) {
-        if_stmt();
-    } else if (strcmp(t.token,"WHILE")==0) {
-        while_stmt();
-    } else if (strcmp(t.token,"FOR")==0) {
-        for_stmt();
-    } else if (strcmp(t.token,"LBRACE")==0) {
-        block();
-    } else {
-        expr_stmt();
+        break;
+    }
+    case TK_IF:     if_stmt(); break;
+    case TK_WHILE:  while_stmt(); break;
+    case TK_FOR:    for_stmt(); break;
+    case TK_LBRACE: block(); break;
+    default:        expr_stmt(); break;
     }
 }
 
 /* block: '{' stmt_list_opt '}' */
 static void block(void) {
-    if (!match("LBRACE", NULL)) { syn_error("{ missing"); return; }
+    if (!match(TK_LBRACE, NULL)) { syn_error("{ missing"); return; }
     stmt_list_opt();
-    if (!match("RBRACE", NULL)) syn_error("} missing");
+    if (!match(TK_RBRACE, NULL)) syn_error("} missing");
 }
 
 /* expr_stmt: expression ';' | ';' */
 static void expr_stmt(void) {
-    if (match("SEMICOLON", NULL)) return;
+    if (match(TK_SEMICOLON, NULL)) return;
     int expr_type = TYPE_ERROR;
     if (!expression_if_any(&expr_type))
         syn_error("Identifier or integer constant expected");
-    if (!match("SEMICOLON", NULL)) syn_error("Semicolon expected");
+    if (!match(TK_SEMICOLON, NULL)) syn_error("Semicolon expected");
 }
 
 /* if_stmt: IF '(' expression ')' block [ ELSE block ] */
 static void if_stmt(void) {
-    if (!match("IF", NULL)) { syn_error("IF expected"); return; }
-    if (!match("LPAREN", NULL)) syn_error("Opening parenthesis missing");
+    if (!match(TK_IF, NULL)) { syn_error("IF expected"); return; }
+    if (!match(TK_LPAREN, NULL)) syn_error("Opening parenthesis missing");
 
     int cond_type = TYPE_ERROR;
     if (!expression_if_any(&cond_type))
         syn_error("Identifier or integer constant expected");
     else if (cond_type != TYPE_INT && cond_type != TYPE_ERROR) {
-        Tok t = LA();
-        semantic_error("Integer expected in conditional expression.", t.line);
+        semantic_error("Integer expected in conditional expression.", LA()->line);
     }
 
-    if (!match("RPAREN", NULL)) syn_error("Closing parenthesis missing");
+    if (!match(TK_RPAREN, NULL)) syn_error("Closing parenthesis missing");
     block();
-    if (match("ELSE", NULL)) block();
+    if (match(TK_ELSE, NULL)) block();
 }
 
 /* while_stmt: WHILE '(' expression ')' block */
 static void while_stmt(void) {
-    if (!match("WHILE", NULL)) { syn_error("WHILE expected"); return; }
-    if (!match("LPAREN", NULL)) syn_error("Opening parenthesis missing");
+    if (!match(TK_WHILE, NULL)) { syn_error("WHILE expected"); return; }
+    if (!match(TK_LPAREN, NULL)) syn_error("Opening parenthesis missing");
 
     int cond_type = TYPE_ERROR;
     if (!expression_if_any(&cond_type))
         syn_error("Identifier or integer constant expected");
     else if (cond_type != TYPE_INT && cond_type != TYPE_ERROR) {
-        Tok t = LA();
-        semantic_error("Integer expected in conditional expression.", t.line);
+        semantic_error("Integer expected in conditional expression.", LA()->line);
     }
 
-    if (!match("RPAREN", NULL)) syn_error("Closing parenthesis missing");
+    if (!match(TK_RPAREN, NULL)) syn_error("Closing parenthesis missing");
     block();
 }
 
 /* for_stmt: FOR '(' expression ';' expression ';' expression ')' statement */
 static void for_stmt(void) {
-    if (!match("FOR", NULL)) { syn_error("FOR expected"); return; }
-    if (!match("LPAREN", NULL)) syn_error("Opening parenthesis missing");
+    if (!match(TK_FOR, NULL)) { syn_error("FOR expected"); return; }
+    if (!match(TK_LPAREN, NULL)) syn_error("Opening parenthesis missing");
 
     /* first expression (init) */
     int e1_type = TYPE_ERROR;
     if (!expression_if_any(&e1_type))
         syn_error("Identifier or integer constant expected");
-    if (!match("SEMICOLON", NULL)) syn_error("Semicolon expected");
+    if (!match(TK_SEMICOLON, NULL)) syn_error("Semicolon expected");
 
     /* second expression (condition) must be int */
     int cond_type = TYPE_ERROR;
     if (!expression_if_any(&cond_type))
         syn_error("Identifier or integer constant expected");
     else if (cond_type != TYPE_INT && cond_type != TYPE_ERROR) {
-        Tok t = LA();
-        semantic_error("Integer expected in conditional expression.", t.line);
+        semantic_error("Integer expected in conditional expression.", LA()->line);
     }
-    if (!match("SEMICOLON", NULL)) syn_error("Semicolon expected");
+    if (!match(TK_SEMICOLON, NULL)) syn_error("Semicolon expected");
 
     /* third expression (increment) */
     int e3_type = TYPE_ERROR;
     if (!expression_if_any(&e3_type))
         syn_error("Identifier or integer constant expected");
-    if (!match("RPAREN", NULL)) syn_error("Closing parenthesis missing");
+    if (!match(TK_RPAREN, NULL)) syn_error("Closing parenthesis missing");
 
     statement();
 }
 
 /* ---------- Expression + Type Rules ---------- */
 
-static int is_operator(const char *tk) {
-    return strcmp(tk,"PLUS")==0  || strcmp(tk,"MINUS")==0 ||
-           strcmp(tk,"STAR")==0  || strcmp(tk,"SLASH")==0 ||
-           strcmp(tk,"GT")==0    || strcmp(tk,"LT")==0    ||
-           strcmp(tk,"EQ")==0    || strcmp(tk,"ASSIGN")==0;
+static int is_operator(TokKind tk) {
+    switch (tk) {
+    case TK_PLUS: case TK_MINUS: case TK_STAR: case TK_SLASH:
+    case TK_GT: case TK_LT: case TK_EQ: case TK_ASSIGN:
+        return 1;
+    default:
+        return 0;
+    }
 }
 
-static int apply_binary_op(const char *op, int lhs_type, int rhs_type, int line) {
+static int apply_binary_op(TokKind op, int lhs_type, int rhs_type, int line) {
+    switch (op) {
     /* assignment: lhs and rhs must match */
-    if (strcmp(op,"ASSIGN")==0) {
-        if (lhs_type == TYPE_ERROR || rhs_type == TYPE_ERROR) return TYPE_ERROR;
-        if (lhs_type != rhs_type) {
-            semantic_error("Type mismatch in statement or expression.", line);
-            return TYPE_ERROR;
-        }
-        return lhs_type;
-    }
-
-    /* arithmetic: + - * / */
-    if (strcmp(op,"PLUS")==0 || strcmp(op,"MINUS")==0 ||
-        strcmp(op,"STAR")==0 || strcmp(op,"SLASH")==0) {
+    case TK_ASSIGN:
+    /* arithmetic: + - * / ; int+int -> int, char+char -> char */
+    case TK_PLUS: case TK_MINUS: case TK_STAR: case TK_SLASH:
         if (lhs_type == TYPE_ERROR || rhs_type == TYPE_ERROR) return TYPE_ERROR;
         if (lhs_type != rhs_type) {
             semantic_error("Type mismatch in statement or expression.", line);
             return TYPE_ERROR;
         }
-        /* int+int -> int, char+char -> char */
         return lhs_type;
-    }
 
     /* relational / equality: result is int, both sides same type */
-    if (strcmp(op,"LT")==0 || strcmp(op,"GT")==0 || strcmp(op,"EQ")==0) {
+    case TK_LT: case TK_GT: case TK_EQ:
         if (lhs_type == TYPE_ERROR || rhs_type == TYPE_ERROR) return TYPE_ERROR;
         if (lhs_type != rhs_type) {
             semantic_error("Type mismatch in statement or expression.", line);
             return TYPE_ERROR;
         }
         return TYPE_INT;
-    }
 
-    return TYPE_ERROR;
+    default:
+        return TYPE_ERROR;
+    }
 }
 
 /* expression: (IDENTIFIER|INT_CONST|CHAR_CONST) { op (IDENTIFIER|INT_CONST|CHAR_CONST) } */
 static int expression_if_any(int *out_type) {
-    Tok a = LA();
+    const Tok *a = LA();
     int cur_type;
 
-    if (strcmp(a.token,"IDENTIFIER")==0) {
-        Sym *s = lookup_symbol(a.lexeme);
+    if (a->kind == TK_IDENTIFIER) {
+        Sym *s = lookup_symbol(a->id);
         if (!s) {
-            semantic_error("Undeclared identifier.", a.line);
+            semantic_error("Undeclared identifier.", a->line);
             cur_type = TYPE_ERROR;
         } else {
             cur_type = str_to_type(s->type);
         }
         consume();
-    } else if (strcmp(a.token,"INT_CONST")==0 || strcmp(a.token,"CHAR_CONST")==0) {
-        cur_type = const_token_type(&a);
+    } else if (a->kind == TK_INT_CONST || a->kind == TK_CHAR_CONST) {
+        cur_type = const_token_type(a);
         consume();
     } else {
         return 0; /* no expression */
     }
 
     for (;;) {
-        Tok op = LA();
-        if (!is_operator(op.token)) break;
+        const Tok *op = LA();
+        if (!is_operator(op->kind)) break;
         consume();
 
-        Tok b = LA();
+        const Tok *b = LA();
         int rhs_type;
-        if (strcmp(b.token,"IDENTIFIER")==0) {
-            Sym *s = lookup_symbol(b.lexeme);
+        if (b->kind == TK_IDENTIFIER) {
+            Sym *s = lookup_symbol(b->id);
             if (!s) {
-                semantic_error("Undeclared identifier.", b.line);
+                semantic_error("Undeclared identifier.", b->line);
                 rhs_type = TYPE_ERROR;
             } else {
                 rhs_type = str_to_type(s->type);
             }
             consume();
-        } else if (strcmp(b.token,"INT_CONST")==0 || strcmp(b.token,"CHAR_CONST")==0) {
-            rhs_type = const_token_type(&b);
+        } else if (b->kind == TK_INT_CONST || b->kind == TK_CHAR_CONST) {
+            rhs_type = const_token_type(b);
             consume();
         } else {
             syn_error("Identifier or integer constant expected");
             break;
         }
 
-        cur_type = apply_binary_op(op.token, cur_type, rhs_type, op.line);
+        cur_type = apply_binary_op(op->kind, cur_type, rhs_type, op->line);
     }
 
     if (out_type) *out_type = cur_type;
     return 1;
 }
 
-/* ---------- I/O: Load Tokens, Dump Symbol Table ---------- */
-static int load_tokens(const char *fname) {
-    FILE *f = fopen(fname, "r");
-    if (!f) {
-        fprintf(stderr, "Cannot open %s\n", fname);
-        return 0;
-    }
-
-    ntok = 0;
-
-    char t1[64], t2[256];
-    int line;
-
-    while (!feof(f)) {
-
-        int count = fscanf(f, "%63s %255s %d", t1, t2, &line);
-
-        if (count == EOF || count == 0)
-            break;
-
-        /* If the third value wasn't an integer → SKIP THAT LINE (header or garbage) */
-        if (count != 3) {
-            /* discard the rest of the line */
-            int c;
-            while ((c = fgetc(f)) != '\n' && c != EOF);
-            continue;
-        }
-
-        /* VALID TOKEN — store it */
-        strcpy(toks[ntok].token,  t1);
-        strcpy(toks[ntok].lexeme, t2);
-        toks[ntok].line = line;
-
-        ntok++;
-        if (ntok >= MAXTOK) break;
-    }
+/* ---------- Name Chains, Dump Symbol Table ---------- */
 
-    fclose(f);
+/* Symbol chains for name ids below count, the new ones empty. Streamed
+   tokens bring new names as they come, so the table grows. */
+static int alloc_sym_chains(size_t count) {
+    if (count <= nchains && sym_of_id) return 1;
+    size_t cap = count > 2 * nchains ? count : 2 * nchains;
+    size_t *p = realloc(sym_of_id, (cap ? cap : 1) * sizeof *p);
+    if (!p) { fprintf(stderr, "Out of memory\n"); return 0; }
+    for (size_t i = nchains; i < cap; i++) p[i] = NO_SYM;
+    sym_of_id = p;
+    nchains = cap;
     return 1;
 }
 
-
 static void print_symbol_table(void) {
-    FILE *out = fopen("symbol_table_semantic.txt", "w");
-    if (!out) {
-        fprintf(stderr, "Failed to create symbol_table_semantic.txt\n");
+    OutBuf out;
+    if (!out_open(&out, "symbol_table_semantic.txt")) {
+        fprintf(err_to, "Failed to create symbol_table_semantic.txt\n");
         return;
     }
 
-    fprintf(out, "Lexeme\tType\tScope\tArray size\n");
-    for (int i = 0; i < nsym; i++) {
-        fprintf(out,
-                "%s\t%s\t%s\t%d\n",
-                symtab[i].lexeme,
-                symtab[i].type,
-                symtab[i].scope,
-                symtab[i].array_size);
+    out_str(&out, "Lexeme\tType\tScope\tArray size\n");
+    for (size_t i = 0; i < nsym; i++) {
+        const Sym *s = sym_at(i);
+        out_str(&out, s->lexeme); out_char(&out, '\t');
+        out_str(&out, s->type);   out_char(&out, '\t');
+        out_str(&out, s->scope);  out_char(&out, '\t');
+        out_int(&out, s->array_size);
+        out_char(&out, '\n');
     }
 
-    fclose(out);
+    if (!out_close(&out)) fprintf(err_to, "Failed to write symbol_table_semantic.txt\n");
 }
 
 /* ---------- main ---------- */
 
-int main(void) {
-    if (!load_tokens("tokens.txt")) return 1;
+/* Forget an earlier run's tokens and symbols, and empty every name's chain */
+static void reset(void) {
+    tokens_reset();
+    store_clear(&symtab);
+    nsym = error_count = 0;
+    strcpy(cur_scope, "Global");
+    for (size_t i = 0; i < nchains; i++) sym_of_id[i] = NO_SYM;
+}
 
-    program();
-    print_symbol_table();
+/* Analyse the loaded or streamed tokens and report the error count */
+static int finish(int stats, int symbols) {
+    analyse(err_to, "Analysed", stats, symbols);
 
     if (error_count == 0) {
-        printf("Semantic analysis finished with no errors.\n");
+        fprintf(out_to, "Semantic analysis finished with no errors.\n");
     } else {
-        printf("Semantic analysis finished with %d error(s).\n", error_count);
+        fprintf(out_to, "Semantic analysis finished with %d error(s).\n", error_count);
     }
 
     return 0;
 }
+
+int semantic_run(int argc, char **argv, const TokFile *tokens) {
+    int stats = 0, symbols = !tokens;
+    reset();
+    read_options(argc, argv, &symtab, &stats, &symbols);
+    out_to = stdout;
+    err_to = stderr;
+    if (tokens) take_tokens(tokens);
+    else {
+        int rc = load_tokens(&names);
+        if (rc < 0) return 1;
+        if (rc == 0) {
+            fprintf(stderr, "Cannot open tokens.txt\n");
+            return 1;
+        }
+    }
+    if (!alloc_sym_chains(tok_names)) return 1;
+    return finish(stats, symbols);
+}
+
+int semantic_stream(int argc, char **argv, TokRing *tokens, FILE *out, FILE *err) {
+    int stats = 0, symbols = 0;
+    reset();
+    read_options(argc, argv, &symtab, &stats, &symbols);
+    ring = tokens;
+    out_to = out;
+    err_to = err;
+    return finish(stats, symbols);
+}
+
+#ifndef TARJUMAN
+int main(int argc, char **argv) {
+    return semantic_run(argc, argv, NULL);
+}
+#endif
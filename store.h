@@ -0,0 +1,75 @@
+#ifndef STORE_H
+#define STORE_H
+
+/* Growable storage for the analysers' tokens and symbols. Elements never
+   move once stored: chunk k holds STORE_FIRST << k of them, so a small
+   input costs one small chunk and n elements take about log2(n) chunks.
+   With huge set, chunks of a huge page or more are mapped and advised
+   to use transparent huge pages where the system has them. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#define STORE_FIRST_LOG 8                   /* chunk 0: 256 elements */
+#define STORE_CHUNKS    40
+#define STORE_HUGE_PAGE ((size_t)2 << 20)
+
+typedef struct {
+    char *chunk[STORE_CHUNKS];
+    size_t elem;            /* element size */
+    size_t count;           /* elements stored */
+    int nchunks;
+    int huge;               /* back big chunks with huge pages */
+} Store;
+
+static void *store_chunk(size_t bytes, int huge) {
+#if !defined(_WIN32) && defined(MAP_ANONYMOUS)
+    if (huge && bytes >= STORE_HUGE_PAGE) {
+        bytes = (bytes + STORE_HUGE_PAGE - 1) & ~(STORE_HUGE_PAGE - 1);
+        void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+            madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+            return p;
+        }
+    }
+#else
+    (void)huge;
+#endif
+    void *p = malloc(bytes);
+    if (!p) { fprintf(stderr, "Out of memory\n"); exit(1); }
+    return p;
+}
+
+/* Element i (i < count) */
+static inline void *store_at(const Store *s, size_t i) {
+    size_t j = (i >> STORE_FIRST_LOG) + 1;      /* chunk k holds j in [2^k, 2^(k+1)) */
+    int k = 63 - __builtin_clzll((unsigned long long)j);
+    size_t before = (((size_t)1 << k) - 1) << STORE_FIRST_LOG;
+    return s->chunk[k] + (i - before) * s->elem;
+}
+
+/* Drop every element, keeping the chunks for the next fill */
+static inline void store_clear(Store *s) {
+    s->count = 0;
+}
+
+/* Append a zeroed element and return it */
+static inline void *store_push(Store *s) {
+    size_t cap = (((size_t)1 << s->nchunks) - 1) << STORE_FIRST_LOG;
+    if (s->count == cap) {
+        if (s->nchunks == STORE_CHUNKS) { fprintf(stderr, "Out of memory\n"); exit(1); }
+        s->chunk[s->nchunks] = store_chunk((s->elem << STORE_FIRST_LOG) << s->nchunks, s->huge);
+        s->nchunks++;
+    }
+    void *e = store_at(s, s->count++);
+    memset(e, 0, s->elem);
+    return e;
+}
+
+#endif /* STORE_H */
@@ -1,63 +1,44 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-typedef struct {
-    char token[32];
-    char lexeme[256];
-    int line;
-} Tok;
-
-#define MAXTOK 100000
-static Tok toks[MAXTOK];
-static int ntok = 0;
-static int pos  = 0;
+#include "tokread.h"
+#include "outbuf.h"
+#include "tarjuman.h"
 
 typedef struct {
-    char lexeme[128];
+    const char *lexeme;
     char type[32];
     char scope[64];
     int  array_size;
 } Sym;
 
-#define MAXSYM 4096
-static Sym symtab[MAXSYM];
-static int nsym = 0;
+static Store symtab = { .elem = sizeof(Sym) };
+static size_t nsym = 0;
+
+static Sym *sym_at(size_t i) { return store_at(&symtab, i); }
 
 static char cur_scope[64] = "Global";
 static int error_count = 0;
+static FILE *out_to, *err_to;   /* stdout and stderr, unless the driver defers them */
 
 static void add_symbol(const char *name, const char *type, const char *scope, int arrsz) {
-    if (nsym >= MAXSYM) return;
-    snprintf(symtab[nsym].lexeme, sizeof(symtab[nsym].lexeme), "%s", name);
-    snprintf(symtab[nsym].type,   sizeof(symtab[nsym].type),   "%s", type);
-    snprintf(symtab[nsym].scope,  sizeof(symtab[nsym].scope),  "%s", scope);
-    symtab[nsym].array_size = arrsz;
+    Sym *s = store_push(&symtab);
+    s->lexeme = name;
+    snprintf(s->type,   sizeof(s->type),   "%s", type);
+    snprintf(s->scope,  sizeof(s->scope),  "%s", scope);
+    s->array_size = arrsz;
     nsym++;
 }
 
-static Tok LA(void) { return (pos < ntok) ? toks[pos] : (Tok){"EOF", "", 999999}; }
-static Tok consume(void) { return (pos < ntok) ? toks[pos++] : (Tok){"EOF", "", 999999}; }
-static int match(const char *tk, Tok *out) {
-    Tok a = LA();
-    if (strcmp(a.token, tk) == 0) { if (out) *out=a; consume(); return 1; }
-    return 0;
-}
-
-static void skip_line_tokens(int line) {
-    while (pos < ntok && toks[pos].line == line) pos++;
-}
-
 static void syn_error(const char *msg) {
-    Tok t = LA();
-    fprintf(stderr, "Line %d: %s\n", t.line, msg);
+    const Tok *t = LA();
+    fprintf(err_to, "Line %d: %s\n", t->line, msg);
     error_count++;
-    skip_line_tokens(t.line);
+    skip_line_tokens(t->line);
 }
 
 /* Forward declarations: */
-static void program(void);
 static int  type_specifier(char *out);
 static void global_decl_list(void);
 static void declaration(const char *typestr);
@@ -74,18 +55,25 @@ static void if_stmt(void);
 static void while_stmt(void);
 static void for_stmt(void);
 static int  expression_if_any(void);
-static int  is_operator(const char *tk);
+static int  is_operator(TokKind tk);
 
 /* Helpers */
-static const char* norm_type_token(const char *tk) {
-    if (strcmp(tk,"VOID")==0) return "Void";
-    if (strcmp(tk,"CHAR")==0) return "Char";
-    if (strcmp(tk,"INT")==0)  return "Int";
-    return "?";
+static const char* norm_type_token(TokKind tk) {
+    switch (tk) {
+    case TK_VOID: return "Void";
+    case TK_CHAR: return "Char";
+    case TK_INT:  return "Int";
+    default:      return "?";
+    }
+}
+
+static int is_type_token(TokKind tk) {
+    return tk == TK_VOID || tk == TK_CHAR || tk == TK_INT;
 }
 
-static int is_type_token(const char *tk) {
-    return strcmp(tk,"VOID")==0 || strcmp(tk,"CHAR")==0 || strcmp(tk,"INT")==0;
+/* IDENTIFIER | INT_CONST | CHAR_CONST */
+static int is_operand(TokKind tk) {
+    return tk == TK_IDENTIFIER || tk == TK_INT_CONST || tk == TK_CHAR_CONST;
 }
 
 /* program: global_decl_list function_def */
@@ -100,15 +88,10 @@ static void program(void) {
 /* Parse repeated global declarations until a type followed by MAIN is seen */
 static void global_decl_list(void) {
     for (;;) {
-        Tok t = LA();
-        if (!is_type_token(t.token)) return;
+        if (!is_type_token(peek())) return;
 
         /* Lookahead to see if this starts the function_def: type MAIN */
-        Tok save = t;
-        consume();
-        Tok t2 = LA();
-        pos--;
-        if (strcmp(t2.token, "MAIN") == 0) return;
+        if (peek2() == TK_MAIN) return;
 
         char ty[16];
         if (!type_specifier(ty)) { syn_error("Any keyword expected"); return; }
@@ -118,9 +101,9 @@ static void global_decl_list(void) {
 
 /* type_specifier: VOID | CHAR | INT  -> writes normalized name */
 static int type_specifier(char *out) {
-    Tok t = LA();
-    if (strcmp(t.token,"VOID")==0 || strcmp(t.token,"CHAR")==0 || strcmp(t.token,"INT")==0) {
-        const char *n = norm_type_token(t.token);
+    TokKind k = peek();
+    if (is_type_token(k)) {
+        const char *n = norm_type_token(k);
         strcpy(out, n);
         consume();
         return 1;
@@ -131,152 +114,153 @@ static int type_specifier(char *out) {
 /* declaration: type_specifier init_declarator_list ';' */
 static void declaration(const char *typestr) {
     init_declarator_list(typestr);
-    if (!match("SEMICOLON", NULL)) syn_error("Semicolon expected");
+    if (!match(TK_SEMICOLON, NULL)) syn_error("Semicolon expected");
 }
 
 /* init_declarator_list: init_declarator { ',' init_declarator } */
 static void init_declarator_list(const char *typestr) {
     init_declarator(typestr);
-    while (match("COMMA", NULL)) {
+    while (match(TK_COMMA, NULL)) {
         init_declarator(typestr);
     }
 }
 
 /* init_declarator: IDENTIFIER array_opt init_opt */
 static void init_declarator(const char *typestr) {
-    Tok id;
-    if (!match("IDENTIFIER", &id)) { syn_error("Identifier expected"); return; }
+    const Tok *id;
+    if (!match(TK_IDENTIFIER, &id)) { syn_error("Identifier expected"); return; }
+    const char *name = id->lexeme;     /* error recovery may skip past id's ring batch */
     int arrsz = -1;
     array_opt(&arrsz);
     init_opt();
-    add_symbol(id.lexeme, typestr, cur_scope, arrsz);
+    add_symbol(name, typestr, cur_scope, arrsz);
 }
 
 /* array_opt: empty | '[' INT_CONST? ']' */
 static int array_opt(int *size_out) {
-    if (!match("LBRACKET", NULL)) return 0;
+    if (!match(TK_LBRACKET, NULL)) return 0;
     int size = 0;
-    Tok num;
-    if (match("INT_CONST", &num)) size = atoi(num.lexeme);
-    if (!match("RBRACKET", NULL)) syn_error("Right bracket expected");
+    const Tok *num;
+    if (match(TK_INT_CONST, &num)) {
+        if (!num->out_of_range) size = num->value;
+        else {
+            fprintf(err_to, "Line %d: Array size out of range\n", num->line);
+            error_count++;
+        }
+    }
+    if (!match(TK_RBRACKET, NULL)) syn_error("Right bracket expected");
     if (size_out) *size_out = size;
     return 1;
 }
 
 /* init_opt: empty | '=' (INT_CONST | CHAR_CONST) */
 static int init_opt(void) {
-    if (!match("ASSIGN", NULL)) return 0;
-    Tok t = LA();
-    if (strcmp(t.token,"INT_CONST")==0 || strcmp(t.token,"CHAR_CONST")==0) { consume(); return 1; }
+    if (!match(TK_ASSIGN, NULL)) return 0;
+    TokKind k = peek();
+    if (k == TK_INT_CONST || k == TK_CHAR_CONST) { consume(); return 1; }
     syn_error("Identifier or integer constant expected");
     return 1;
 }
 
 /* function_def: type_specifier MAIN '(' type_specifier ')' '{' stmt_list_opt '}' */
 static void function_def(const char *ret_type) {
-    if (!match("MAIN", NULL)) { syn_error("MAIN expected"); return; }
+    if (!match(TK_MAIN, NULL)) { syn_error("MAIN expected"); return; }
     add_symbol("main", "Function", "Global", -1);
 
-    if (!match("LPAREN", NULL)) syn_error("Opening parenthesis missing");
+    if (!match(TK_LPAREN, NULL)) syn_error("Opening parenthesis missing");
     char pty[16];
     if (!type_specifier(pty)) syn_error("Any keyword expected");
-    if (!match("RPAREN", NULL)) syn_error("Closing parenthesis missing");
-    if (!match("LBRACE", NULL)) syn_error("{ missing");
+    if (!match(TK_RPAREN, NULL)) syn_error("Closing parenthesis missing");
+    if (!match(TK_LBRACE, NULL)) syn_error("{ missing");
 
     strcpy(cur_scope, "Main");
     stmt_list_opt();
 
-    if (!match("RBRACE", NULL)) syn_error("} missing");
+    if (!match(TK_RBRACE, NULL)) syn_error("} missing");
     strcpy(cur_scope, "Global");
 }
 
 /* stmt_list_opt: { statement } */
 static void stmt_list_opt(void) {
     for (;;) {
-        Tok t = LA();
-        if (strcmp(t.token,"RBRACE")==0 || strcmp(t.token,"EOF")==0) return;
+        TokKind k = peek();
+        if (k == TK_RBRACE || k == TK_EOF) return;
         statement();
     }
 }
 
 /* statement: block | declaration | expr_stmt | if_stmt | while_stmt | for_stmt */
 static void statement(void) {
-    Tok t = LA();
-    if (strcmp(t.token,"LBRACE")==0) { block(); return; }
-    if (strcmp(t.token,"IF")==0)     { if_stmt(); return; }
-    if (strcmp(t.token,"WHILE")==0)  { while_stmt(); return; }
-    if (strcmp(t.token,"FOR")==0)    { for_stmt(); return; }
-    if (is_type_token(t.token)) {
+    switch (peek()) {
+    case TK_LBRACE: block(); return;
+    case TK_IF:     if_stmt(); return;
+    case TK_WHILE:  while_stmt(); return;
+    case TK_FOR:    for_stmt(); return;
+    case TK_VOID: case TK_CHAR: case TK_INT: {
         char ty[16]; if (!type_specifier(ty)) { syn_error("Any keyword expected"); return; }
         declaration(ty); return;
     }
-    expr_stmt();
+    default:        expr_stmt(); return;
+    }
 }
 
 /* block: '{' stmt_list_opt '}' */
 static void block(void) {
-    if (!match("LBRACE", NULL)) { syn_error("{ missing"); return; }
+    if (!match(TK_LBRACE, NULL)) { syn_error("{ missing"); return; }
     stmt_list_opt();
-    if (!match("RBRACE", NULL)) syn_error("} missing");
+    if (!match(TK_RBRACE, NULL)) syn_error("} missing");
 }
 
 /* expr_stmt: expression ';' | ';' */
 static void expr_stmt(void) {
-    if (match("SEMICOLON", NULL)) return;
+    if (match(TK_SEMICOLON, NULL)) return;
     if (!expression_if_any()) syn_error("Identifier or integer constant expected");
-    if (!match("SEMICOLON", NULL)) syn_error("Semicolon expected");
+    if (!match(TK_SEMICOLON, NULL)) syn_error("Semicolon expected");
 }
 
 /* if_stmt: IF '(' expression ')' block [ ELSE block ] */
 static void if_stmt(void) {
-    if (!match("IF", NULL)) { syn_error("IF expected"); return; }
-    if (!match("LPAREN", NULL)) syn_error("Opening parenthesis missing");
+    if (!match(TK_IF, NULL)) { syn_error("IF expected"); return; }
+    if (!match(TK_LPAREN, NULL)) syn_error("Opening parenthesis missing");
     if (!expression_if_any()) syn_error("Identifier or integer constant expected");
-    if (!match("RPAREN", NULL)) syn_error("Closing parenthesis missing");
+    if (!match(TK_RPAREN, NULL)) syn_error("Closing parenthesis missing");
     block();
-    if (match("ELSE", NULL)) block();
+    if (match(TK_ELSE, NULL)) block();
 }
 
 /* while_stmt: WHILE '(' expression ')' block */
 static void while_stmt(void) {
-    if (!match("WHILE", NULL)) { syn_error("WHILE expected"); return; }
-    if (!match("LPAREN", NULL)) syn_error("Opening parenthesis missing");
+    if (!match(TK_WHILE, NULL)) { syn_error("WHILE expected"); return; }
+    if (!match(TK_LPAREN, NULL)) syn_error("Opening parenthesis missing");
     if (!expression_if_any()) syn_error("Identifier or integer constant expected");
-    if (!match("RPAREN", NULL)) syn_error("Closing parenthesis missing");
+    if (!match(TK_RPAREN, NULL)) syn_error("Closing parenthesis missing");
     block();
 }
 
 /* for_stmt: FOR '(' expression ';' expression ';' expression ')' statement */
 static void for_stmt(void) {
-    if (!match("FOR", NULL)) { syn_error("FOR expected"); return; }
-    if (!match("LPAREN", NULL)) syn_error("Opening parenthesis missing");
+    if (!match(TK_FOR, NULL)) { syn_error("FOR expected"); return; }
+    if (!match(TK_LPAREN, NULL)) syn_error("Opening parenthesis missing");
     if (!expression_if_any()) syn_error("Identifier or integer constant expected");
-    if (!match("SEMICOLON", NULL)) syn_error("Semicolon expected");
+    if (!match(TK_SEMICOLON, NULL)) syn_error("Semicolon expected");
     if (!expression_if_any()) syn_error("Identifier or integer constant expected");
-    if (!match("SEMICOLON", NULL)) syn_error("Semicolon expected");
+    if (!match(TK_SEMICOLON, NULL)) syn_error("Semicolon expected");
     if (!expression_if_any()) syn_error("Identifier or integer constant expected");
-    if (!match("RPAREN", NULL)) syn_error("Closing parenthesis missing");
+    if (!match(TK_RPAREN, NULL)) syn_error("Closing parenthesis missing");
     statement();
 }
 
 /* expression: (IDENTIFIER|INT_CONST|CHAR_CONST) { op (IDENTIFIER|INT_CONST|CHAR_CONST) } */
 static int expression_if_any(void) {
-    Tok a = LA();
-    if (strcmp(a.token,"IDENTIFIER")==0 ||
-        strcmp(a.token,"INT_CONST")==0 ||
-        strcmp(a.token,"CHAR_CONST")==0) {
+    if (is_operand(peek())) {
         consume();
     } else {
         return 0;
     }
     for (;;) {
-        Tok op = LA();
-        if (!is_operator(op.token)) break;
+        if (!is_operator(peek())) break;
         consume();
-        Tok b = LA();
-        if (strcmp(b.token,"IDENTIFIER")==0 ||
-            strcmp(b.token,"INT_CONST")==0 ||
-            strcmp(b.token,"CHAR_CONST")==0) {
+        if (is_operand(peek())) {
             consume();
         } else {
             syn_error("Identifier or integer constant expected");
@@ -286,87 +270,77 @@ static int expression_if_any(void) {
     return 1;
 }
 
-static int is_operator(const char *tk) {
-    return strcmp(tk,"PLUS")==0 || strcmp(tk,"MINUS")==0 || strcmp(tk,"STAR")==0 ||
-           strcmp(tk,"SLASH")==0 || strcmp(tk,"GT")==0   || strcmp(tk,"LT")==0   ||
-           strcmp(tk,"ASSIGN")==0 || strcmp(tk,"EQ")==0;
-}
-
-/* Token file reader: tolerates presence of a header line "Token  Lexeme  Line No" */
-static int read_tokens(const char *fname) {
-    FILE *f = fopen(fname, "r");
-    if (!f) return 0;
-    char line[2048];
-    int first = 1;
-    while (fgets(line, sizeof(line), f)) {
-        if (first) {
-            first = 0;
-            char h1[32], h2[32], h3[32];
-            if (sscanf(line, " %31s %31s %31s", h1, h2, h3) == 3) {
-                if ((strcmp(h1,"Token")==0 || strcmp(h1,"TOKEN")==0) &&
-                    (strcmp(h2,"Lexeme")==0 || strcmp(h2,"LEXEME")==0) &&
-                    (strcmp(h3,"Line")==0 || strstr(h3,"Line")==h3)) {
-                    continue; /* skip header */
-                }
-            }
-        }
-        char tkn[64], lex[512];
-        int ln = 0;
-
-        char *p = line;
-        while (*p && isspace((unsigned char)*p)) p++;
-
-        int i=0; while (*p && !isspace((unsigned char)*p) && i<63) tkn[i++]=*p++;
-        tkn[i]=0;
-        while (*p && isspace((unsigned char)*p)) p++;
-
-        i=0; while (*p && *p!='\t' && *p!='\n' && i<511) lex[i++]=*p++;
-        lex[i]=0;
-        while (*p && isspace((unsigned char)*p)) p++;
-
-        if (*p) ln = atoi(p);
-
-        if (tkn[0]==0) continue;
-
-        if (ntok < MAXTOK) {
-            strncpy(toks[ntok].token, tkn, sizeof(toks[ntok].token)-1);
-            toks[ntok].token[sizeof(toks[ntok].token)-1]=0;
-            strncpy(toks[ntok].lexeme, lex, sizeof(toks[ntok].lexeme)-1);
-            toks[ntok].lexeme[sizeof(toks[ntok].lexeme)-1]=0;
-            toks[ntok].line = ln ? ln : 0;
-            ntok++;
-        }
+static int is_operator(TokKind tk) {
+    switch (tk) {
+    case TK_PLUS: case TK_MINUS: case TK_STAR: case TK_SLASH:
+    case TK_GT: case TK_LT: case TK_ASSIGN: case TK_EQ:
+        return 1;
+    default:
+        return 0;
     }
-    fclose(f);
-    return 1;
 }
 
 static void print_symbol_table(void) {
-    FILE *out = fopen("symbol_table.txt", "w");
-    if (!out) {
-        fprintf(stderr, "Failed to create symbol_table.txt\n");
+    OutBuf out;
+    if (!out_open(&out, "symbol_table.txt")) {
+        fprintf(err_to, "Failed to create symbol_table.txt\n");
         return;
     }
 
-    fprintf(out, "Lexeme\tType\tScope\tArray size\n");
-    for (int i = 0; i < nsym; i++) {
-        fprintf(out, "%s\t%s\t%s\t", symtab[i].lexeme, symtab[i].type, symtab[i].scope);
-        if (symtab[i].array_size >= 0)
-            fprintf(out, "%d\n", symtab[i].array_size);
-        else
-            fprintf(out, "\n");
+    out_str(&out, "Lexeme\tType\tScope\tArray size\n");
+    for (size_t i = 0; i < nsym; i++) {
+        const Sym *s = sym_at(i);
+        out_str(&out, s->lexeme); out_char(&out, '\t');
+        out_str(&out, s->type);   out_char(&out, '\t');
+        out_str(&out, s->scope);  out_char(&out, '\t');
+        if (s->array_size >= 0) out_int(&out, s->array_size);
+        out_char(&out, '\n');
     }
 
-    fclose(out);
-    printf("Symbol table written to symbol_table.txt\n");
+    if (!out_close(&out)) fprintf(err_to, "Failed to write symbol_table.txt\n");
+    fprintf(out_to, "Symbol table written to symbol_table.txt\n");
 }
 
-int main(void) {
-    if (!read_tokens("tokens.txt")) {
-        fprintf(stderr, "Failed to open tokens.txt\n");
-        return 1;
+/* Forget an earlier run's tokens and symbols */
+static void reset(void) {
+    tokens_reset();
+    store_clear(&symtab);
+    nsym = error_count = 0;
+    strcpy(cur_scope, "Global");
+}
+
+int syntax_run(int argc, char **argv, const TokFile *tokens) {
+    int stats = 0, symbols = !tokens;
+    reset();
+    read_options(argc, argv, &symtab, &stats, &symbols);
+    out_to = stdout;
+    err_to = stderr;
+    if (tokens) take_tokens(tokens);
+    else {
+        int rc = load_tokens(NULL);
+        if (rc < 0) return 1;
+        if (rc == 0) {
+            fprintf(stderr, "Failed to open tokens.txt\n");
+            return 1;
+        }
     }
-    program();
-    print_symbol_table();
+    analyse(err_to, "Parsed", stats, symbols);
     return 0;
-}
\ No newline at end of file
+}
+
+int syntax_stream(int argc, char **argv, TokRing *tokens, FILE *out, FILE *err) {
+    int stats = 0, symbols = 0;
+    reset();
+    read_options(argc, argv, &symtab, &stats, &symbols);
+    ring = tokens;
+    out_to = out;
+    err_to = err;
+    analyse(err_to, "Parsed", stats, symbols);
+    return 0;
+}
+
+#ifndef TARJUMAN
+int main(int argc, char **argv) {
+    return syntax_run(argc, argv, NULL);
+}
+#endif
@@ -0,0 +1,333 @@
+/* tarjuman: lexical, syntax and semantic analysis in one process. The
+   lexer's tokens reach both analysers in memory (see tarjuman.h), so no
+   token file is written or parsed. The three phases run at once, the
+   analysers taking tokens from the lexer as they are made; their output
+   is held back until the phases before them are done, so diagnostics
+   read as from running the three programs in turn. Files are written
+   only when asked for:
+
+       --tokens      also write tokens.txt (the lexer's --text)
+       --symbols     write symbol_table.txt and symbol_table_semantic.txt
+       --stats, --hugepages    as for the analysers
+       --sequential  lex the whole input first, then analyse
+
+   The input file and the lexer's own options (--index, --caret, --jobs N,
+   --edit OFF LEN TEXT) go to the lexer.
+
+   tarjuman --serve [PATH] instead runs as a compile server on a Unix
+   socket (tjserve.h), for tarjumanc, which also stands in for the three
+   programs on their own. The server first runs a small program through
+   the phases, so each request's child, forked from it, starts with the
+   code paged in and the phases' storage allocated. A client that is slow
+   to send, or stops reading its output, holds up only its own child,
+   and that only until the child's deadline (tjserve.h). */
+
+#define _GNU_SOURCE         /* struct ucred, for tjserve.h */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+
+#include "tjserve.h"
+#endif
+
+#include "tarjuman.h"
+
+typedef struct {
+    int argc;
+    char **argv;
+    TokRing **rings;        /* the lexer's */
+    TokRing *ring;          /* an analyser's, */
+    FILE *out, *err;        /* and where its output is held */
+    int rc;
+} Phase;
+
+static void *lex_thread(void *arg) {
+    Phase *p = arg;
+    p->rc = lexical_stream(p->argc, p->argv, p->rings, 2);
+    return NULL;
+}
+
+static void *syntax_thread(void *arg) {
+    Phase *p = arg;
+    p->rc = syntax_stream(p->argc, p->argv, p->ring, p->out, p->err);
+    return NULL;
+}
+
+/* Write out held output and close it */
+static void replay(FILE *held, FILE *to) {
+    char buf[1 << 16];
+    size_t n;
+    rewind(held);
+    while ((n = fread(buf, 1, sizeof buf, held)) > 0) fwrite(buf, 1, n, to);
+    fclose(held);
+}
+
+/* src != NULL: lex src[0, len) rather than the input file */
+static int run_sequential(int lex_argc, char **lex_argv, int ana_argc, char **ana_argv,
+                          const unsigned char *src, size_t len) {
+    TokFile tokens;
+    memset(&tokens, 0, sizeof tokens);
+    int rc = src ? lexical_run_buffer(lex_argc, lex_argv, src, len, &tokens)
+                 : lexical_run(lex_argc, lex_argv, &tokens);
+    if (rc == 0) rc = syntax_run(ana_argc, ana_argv, &tokens);
+    if (rc == 0) rc = semantic_run(ana_argc, ana_argv, &tokens);
+    return rc;
+}
+
+/* The lexer and the syntax analyser on threads of their own, the semantic
+   analyser on this one. -1 if nothing has run yet, so the phases can run
+   in turn instead. */
+static int run_streamed(int lex_argc, char **lex_argv, int ana_argc, char **ana_argv) {
+    FILE *held[4];          /* syntax stdout, stderr; semantic stdout, stderr */
+    for (int k = 0; k < 4; k++)
+        if (!(held[k] = tmpfile())) {
+            while (k--) fclose(held[k]);
+            return -1;
+        }
+    TokRing *rings[2] = { tokring_new(), tokring_new() };
+    Phase lex = { lex_argc, lex_argv, rings, NULL, NULL, NULL, 0 };
+    Phase syn = { ana_argc, ana_argv, NULL, rings[0], held[0], held[1], 0 };
+    pthread_t lt, st;
+    int rc = -1, started = pthread_create(&st, NULL, syntax_thread, &syn) == 0;
+    if (started && pthread_create(&lt, NULL, lex_thread, &lex) != 0) {
+        /* the syntax analyser has begun; it cannot be run again */
+        tokring_close(rings[0], 1);
+        pthread_join(st, NULL);
+        fprintf(stderr, "Failed to start the lexer thread.\n");
+        started = 0;
+        rc = 1;
+    }
+    if (started) {
+        int sem_rc = semantic_stream(ana_argc, ana_argv, rings[1], held[2], held[3]);
+        pthread_join(lt, NULL);
+        pthread_join(st, NULL);
+        rc = lex.rc;
+        if (rc == 0) {
+            replay(held[1], stderr);
+            replay(held[0], stdout);
+            held[0] = held[1] = NULL;
+            rc = syn.rc;
+        }
+        if (rc == 0) {
+            replay(held[3], stderr);
+            replay(held[2], stdout);
+            held[2] = held[3] = NULL;
+            rc = sem_rc;
+        }
+    }
+    for (int k = 0; k < 4; k++) if (held[k]) fclose(held[k]);
+    tokring_free(rings[0]);
+    tokring_free(rings[1]);
+    return rc;
+}
+
+/* One run over argv, as from the command line. src != NULL: lex that
+   instead of the input file, in turn. */
+static int run(int argc, char **argv, const unsigned char *src, size_t len) {
+    char **lex_argv = malloc((size_t)(argc + 1) * sizeof *lex_argv);
+    char *ana_argv[5] = { argv[0] };
+    int lex_argc = 1, ana_argc = 1, sequential = src != NULL;
+    if (!lex_argv) { fprintf(stderr, "Out of memory\n"); return 1; }
+    lex_argv[0] = argv[0];
+    for (int i = 1; i < argc; i++) {
+        int values = 0;
+        if (strcmp(argv[i], "--tokens") == 0) lex_argv[lex_argc++] = "--text";
+        else if (strcmp(argv[i], "--sequential") == 0) sequential = 1;
+        else if (strcmp(argv[i], "--symbols") == 0 || strcmp(argv[i], "--stats") == 0 ||
+                 strcmp(argv[i], "--hugepages") == 0) {
+            if (ana_argc < 4) ana_argv[ana_argc++] = argv[i];
+        }
+        else {
+            if (strcmp(argv[i], "--jobs") == 0) values = 1;
+            else if (strcmp(argv[i], "--edit") == 0) values = 3;
+            for (int k = 0; k <= values && i < argc; k++) lex_argv[lex_argc++] = argv[i++];
+            i--;
+        }
+    }
+    lex_argv[lex_argc] = NULL;
+    ana_argv[ana_argc] = NULL;
+
+    int rc = sequential ? -1 : run_streamed(lex_argc, lex_argv, ana_argc, ana_argv);
+    if (rc < 0) rc = run_sequential(lex_argc, lex_argv, ana_argc, ana_argv, src, len);
+    free(lex_argv);
+    return rc;
+}
+
+#ifndef _WIN32
+/* ---------- compile server ---------- */
+
+static const char *const program_name[TJ_NPROGRAMS] = {
+    "tarjuman", "lexical", "syntax", "semantic"
+};
+
+/* Run one request in the client's directory, with its stdout and stderr
+   in place of this process's. Runs in a child of the server, which exits
+   after, or is ended by SIGALRM when the request overruns. -1 if the
+   request is malformed. */
+static int32_t serve_request(int c) {
+    TjRequest rq;
+    int fds[TJ_NFDS];
+    alarm(TJ_TIMEOUT);          /* a silent client ends the child, not the server */
+    if (!tj_recv_fds(c, &rq, sizeof rq, fds, TJ_NFDS)) return -1;
+    char *args = NULL, *argv[TJ_MAX_ARGS + 2] = { NULL };
+    unsigned char *src = NULL;
+    int argc = 1, ok = memcmp(rq.magic, TJ_MAGIC, 8) == 0 && rq.program < TJ_NPROGRAMS &&
+                       rq.nargs <= TJ_MAX_ARGS && rq.args_len <= TJ_ARGS_MAX &&
+                       rq.source_len < SIZE_MAX / 2;
+    if (ok) argv[0] = (char *)program_name[rq.program];
+    if (ok) ok = (args = malloc(rq.args_len + 1)) != NULL && tj_read(c, args, rq.args_len) &&
+                 (rq.args_len == 0 || args[rq.args_len - 1] == 0);
+    for (uint32_t at = 0; ok && at < rq.args_len; at += (uint32_t)strlen(args + at) + 1) {
+        if (argc > (int)rq.nargs) ok = 0;
+        else argv[argc++] = args + at;
+    }
+    if (ok && argc != (int)rq.nargs + 1) ok = 0;
+    argv[argc] = NULL;
+    if (ok) ok = (src = malloc((size_t)rq.source_len + 1)) != NULL &&
+                 tj_read(c, src, (size_t)rq.source_len);
+    alarm(TJ_RUN_TIMEOUT);      /* nor can one that stops reading its output */
+
+    int32_t rc = -1;
+    if (ok) {
+        dup2(fds[1], 1);
+        dup2(fds[2], 2);
+        if (fchdir(fds[0]) != 0) {
+            fprintf(stderr, "Failed to enter the working directory.\n");
+            rc = 1;
+        }
+        else switch (rq.program) {
+        case TJ_LEXICAL:  rc = lexical_run_buffer(argc, argv, src, (size_t)rq.source_len, NULL); break;
+        case TJ_SYNTAX:   rc = syntax_run(argc, argv, NULL); break;
+        case TJ_SEMANTIC: rc = semantic_run(argc, argv, NULL); break;
+        default:          rc = run(argc, argv, src, (size_t)rq.source_len); break;
+        }
+        fflush(stdout);
+        fflush(stderr);
+    }
+    free(args);
+    free(src);
+    for (int k = 0; k < TJ_NFDS; k++) close(fds[k]);
+    return rc;
+}
+
+/* Run a small program through the phases, as tarjuman would lex it from
+   a request, with the output thrown away. The children forked after
+   inherit what that allocates; each run clears it for its own use. */
+static void warm_up(void) {
+    static const char prog[] =
+        "int a[4], b = 1;\nchar c = 'x';\n"
+        "int main(void) {\n    a = b + 2;\n    if (a > b) { b = a; }\n}\n";
+    char *argv[] = { (char *)program_name[TJ_TARJUMAN], NULL };
+    int null = open("/dev/null", O_WRONLY), out = dup(1), err = dup(2);
+    if (null < 0 || out < 0 || err < 0) {
+        if (null >= 0) close(null);
+        if (out >= 0) close(out);
+        if (err >= 0) close(err);
+        return;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    dup2(null, 1);
+    dup2(null, 2);
+    run(1, argv, (const unsigned char *)prog, sizeof prog - 1);
+    fflush(stdout);
+    fflush(stderr);
+    dup2(out, 1);
+    dup2(err, 2);
+    close(null);
+    close(out);
+    close(err);
+}
+
+static volatile sig_atomic_t live;     /* children serving requests */
+
+/* SIGCHLD: reap the children that have ended */
+static void reap(int sig) {
+    (void)sig;
+    int e = errno;
+    while (waitpid(-1, NULL, WNOHANG) > 0) live--;
+    errno = e;
+}
+
+/* Serve requests on path until killed, each in a child of its own, at
+   most TJ_MAX_CLIENTS at once */
+static int serve(const char *path) {
+    struct sockaddr_un a;
+    if (!tj_socket_path(&a, path, 1)) return 1;
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0) { fprintf(stderr, "Failed to create the socket.\n"); return 1; }
+    if (connect(s, (struct sockaddr *)&a, sizeof a) == 0) {
+        fprintf(stderr, "A server is already running on %s.\n", a.sun_path);
+        return 1;
+    }
+    close(s);
+    unlink(a.sun_path);
+    s = socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t mask = umask(077);   /* the socket is for this user only */
+    int bound = s >= 0 && bind(s, (struct sockaddr *)&a, sizeof a) == 0;
+    umask(mask);
+    if (!bound || listen(s, 16) != 0) {
+        fprintf(stderr, "Failed to listen on %s.\n", a.sun_path);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    warm_up();
+    /* children are reaped as they end; SIGCHLD gets in only while waiting
+       in pselect(), so live changes nowhere else */
+    sigset_t chld, open_mask;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &open_mask);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = reap;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+    for (;;) {
+        /* a connection, or with TJ_MAX_CLIENTS children running, one of
+           them ending */
+        fd_set ready;
+        FD_ZERO(&ready);
+        if (live < TJ_MAX_CLIENTS) FD_SET(s, &ready);
+        if (pselect(s + 1, &ready, NULL, NULL, NULL, &open_mask) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Failed to wait for a connection.\n");
+            return 1;
+        }
+        int c = accept(s, NULL, NULL);
+        if (c < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "Failed to accept a connection.\n");
+            return 1;
+        }
+        if (!tj_peer_is_me(c)) { close(c); continue; }
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(s);
+            signal(SIGCHLD, SIG_DFL);
+            sigprocmask(SIG_SETMASK, &open_mask, NULL);
+            int32_t rc = serve_request(c);
+            if (rc >= 0) tj_write(c, &rc, sizeof rc);
+            _exit(0);
+        }
+        if (pid < 0) fprintf(stderr, "Failed to start a child for a request.\n");
+        else live++;
+        close(c);
+    }
+}
+#endif
+
+int main(int argc, char **argv) {
+#ifndef _WIN32
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0) return serve(argc > 2 ? argv[2] : NULL);
+#endif
+    return run(argc, argv, NULL, 0);
+}
@@ -0,0 +1,44 @@
+#ifndef TARJUMAN_H
+#define TARJUMAN_H
+
+/* Phase entry points. Each program's main() is its run function with no
+   in-memory tokens. Built with -DTARJUMAN the mains drop out, and the
+   tarjuman driver links all three phases into one process:
+
+       gcc -O2 -pthread -DTARJUMAN tarjuman.c lexical_analyser.c \
+           syntax_analyser.c sematic_analyser.c -o tarjuman
+
+   By default the lexer runs on its own thread and streams its tokens to
+   both analysers through rings (tokring.h), each analyser on a thread of
+   its own. With --sequential the lexer instead fills a TokFile in memory,
+   laid out as tokens.bin would be, and the analysers then read it. That
+   way starts from a clean state each time, keeping allocated storage, so
+   the compile server (tarjuman --serve) warms up on it before serving. */
+
+#include <stdio.h>
+
+#include "tokfile.h"
+#include "tokring.h"
+
+/* tokens != NULL: keep the tokens in memory there instead of writing
+   tokens.bin. The TokFile is not mapped; do not tokfile_close() it. */
+int lexical_run(int argc, char **argv, TokFile *tokens);
+
+/* lexical_run on src[0, len) rather than an input file */
+int lexical_run_buffer(int argc, char **argv, const unsigned char *src, size_t len, TokFile *tokens);
+
+/* Lex into the n rings, one per consumer, with no token file; the rings
+   are closed at the end, even when lexing fails */
+int lexical_stream(int argc, char **argv, TokRing **rings, int n);
+
+/* tokens != NULL: analyse those, and write the symbol table only when
+   argv has --symbols. Otherwise load tokens.bin, tokens.tka or tokens.txt. */
+int syntax_run(int argc, char **argv, const TokFile *tokens);
+int semantic_run(int argc, char **argv, const TokFile *tokens);
+
+/* Analyse tokens as they arrive through the ring, which is read to the
+   end; what would go to stdout and stderr goes to out and err */
+int syntax_stream(int argc, char **argv, TokRing *tokens, FILE *out, FILE *err);
+int semantic_stream(int argc, char **argv, TokRing *tokens, FILE *out, FILE *err);
+
+#endif /* TARJUMAN_H */
@@ -0,0 +1,121 @@
+/* tarjumanc: tarjuman's command line, or one of the three programs', run
+   by a compile server (tarjuman --serve) instead of a process of its own.
+   The options, and the source for tarjuman and the lexer, go to the
+   server, which runs them in this directory with this process's stdout
+   and stderr (see tjserve.h); the exit status is the server's.
+
+       gcc -O2 tarjumanc.c -o tarjumanc
+       tarjuman --serve [PATH] &
+       tarjumanc [--socket PATH] [--lexical|--syntax|--semantic] [options] [input file]
+
+   --lexical, --syntax and --semantic take the command line of the
+   lexical, syntax and semantic analysers; so does tarjumanc installed
+   under a name starting with lex, syn or sem. Otherwise it is
+   tarjuman's. With no input file the source is read from stdin. The
+   socket is PATH, else $TARJUMAN_SOCKET, else tarjuman.sock in
+   $XDG_RUNTIME_DIR or /tmp/tarjuman-UID. */
+
+#define _GNU_SOURCE         /* struct ucred, for tjserve.h */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#include "tjserve.h"
+
+/* All of fd into *len bytes at the returned buffer; NULL on failure */
+static unsigned char *read_all(int fd, size_t *len) {
+    size_t cap = 1 << 16, n = 0;
+    unsigned char *buf = malloc(cap);
+    for (;;) {
+        if (!buf) return NULL;
+        if (n == cap) {
+            unsigned char *p = realloc(buf, cap *= 2);
+            if (!p) { free(buf); return NULL; }
+            buf = p;
+        }
+        ssize_t r = read(fd, buf + n, cap - n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) { free(buf); return NULL; }
+        if (r == 0) break;
+        n += (size_t)r;
+    }
+    *len = n;
+    return buf;
+}
+
+/* The program a name starting lex, syn or sem stands for, else tarjuman */
+static uint32_t program_of(const char *name) {
+    const char *base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+    if (strncmp(base, "lex", 3) == 0) return TJ_LEXICAL;
+    if (strncmp(base, "syn", 3) == 0) return TJ_SYNTAX;
+    if (strncmp(base, "sem", 3) == 0) return TJ_SEMANTIC;
+    return TJ_TARJUMAN;
+}
+
+int main(int argc, char **argv) {
+    const char *sock_path = NULL, *infile = NULL;
+    char args[TJ_ARGS_MAX];
+    TjRequest rq;
+    memset(&rq, 0, sizeof rq);
+    memcpy(rq.magic, TJ_MAGIC, 8);
+    rq.program = program_of(argv[0]);
+    for (int i = 1; i < argc; i++) {
+        int values = 0;
+        if (strcmp(argv[i], "--socket") == 0) {
+            if (i + 1 < argc) sock_path = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--lexical") == 0) { rq.program = TJ_LEXICAL; continue; }
+        if (strcmp(argv[i], "--syntax") == 0) { rq.program = TJ_SYNTAX; continue; }
+        if (strcmp(argv[i], "--semantic") == 0) { rq.program = TJ_SEMANTIC; continue; }
+        if (strcmp(argv[i], "--jobs") == 0) values = 1;
+        else if (strcmp(argv[i], "--edit") == 0) values = 3;
+        else if (strncmp(argv[i], "--", 2) != 0) infile = argv[i];
+        for (int k = 0; k <= values && i < argc; k++, i++) {
+            size_t n = strlen(argv[i]) + 1;
+            if (rq.nargs == TJ_MAX_ARGS || n > TJ_ARGS_MAX - rq.args_len) {
+                fprintf(stderr, "Too many options.\n");
+                return 1;
+            }
+            memcpy(args + rq.args_len, argv[i], n);
+            rq.args_len += (uint32_t)n;
+            rq.nargs++;
+        }
+        i--;
+    }
+
+    /* the analysers read token files, not source */
+    size_t len = 0;
+    unsigned char *src = NULL;
+    if (rq.program == TJ_TARJUMAN || rq.program == TJ_LEXICAL) {
+        int in = infile ? open(infile, O_RDONLY) : 0;
+        src = in < 0 ? NULL : read_all(in, &len);
+        if (!src) { fprintf(stderr, "Failed to open input file.\n"); return 1; }
+        if (in > 0) close(in);
+    }
+    rq.source_len = len;
+
+    struct sockaddr_un a;
+    if (!tj_socket_path(&a, sock_path, 0)) return 1;
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0 || connect(s, (struct sockaddr *)&a, sizeof a) != 0) {
+        fprintf(stderr, "No compile server on %s.\n", a.sun_path);
+        return 1;
+    }
+    if (!tj_peer_is_me(s)) {
+        fprintf(stderr, "The compile server on %s is another user's.\n", a.sun_path);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    int fds[TJ_NFDS] = { open(".", O_RDONLY), 1, 2 };
+    int32_t rc;
+    if (fds[0] < 0 || !tj_send_fds(s, &rq, sizeof rq, fds, TJ_NFDS) ||
+        !tj_write(s, args, rq.args_len) || !tj_write(s, src, len) || !tj_read(s, &rc, sizeof rc)) {
+        fprintf(stderr, "The compile server did not answer.\n");
+        return 1;
+    }
+    return rc;
+}
@@ -0,0 +1,193 @@
+#ifndef TJSERVE_H
+#define TJSERVE_H
+
+/* Compile server protocol, between tarjuman --serve and tarjumanc, over a
+   Unix domain stream socket. One request per connection:
+
+       client  TjRequest, carrying three descriptors (SCM_RIGHTS): its
+               working directory, stdout and stderr, and naming the
+               program whose command line it runs
+               nargs options, NUL-terminated (args_len bytes)
+               source_len bytes of source
+       server  int32_t exit status, once the run is over
+
+   The server runs the request in the client's directory with the
+   client's stdout and stderr, so output files and diagnostics land where
+   the programs run directly would put them. tarjuman and the lexer take
+   the source from the request; the analysers send none and read the
+   token files there. A request that has not
+   fully arrived within TJ_TIMEOUT seconds is dropped, and one still
+   running after TJ_RUN_TIMEOUT more, say for a client that stopped
+   reading its output, is ended without a status.
+
+   Each end checks that the other runs as the same user before sending or
+   using descriptors. struct ucred needs _GNU_SOURCE, which includers
+   define before any system header. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#define TJ_MAGIC    "TJSERVE2"
+#define TJ_NFDS     3               /* cwd, stdout, stderr */
+#define TJ_MAX_ARGS 64
+#define TJ_ARGS_MAX 65536
+#define TJ_TIMEOUT  10              /* seconds to send a request */
+#define TJ_RUN_TIMEOUT 60           /* seconds to run it, output included */
+#define TJ_MAX_CLIENTS 16           /* requests served at once */
+
+/* TjRequest.program */
+enum { TJ_TARJUMAN, TJ_LEXICAL, TJ_SYNTAX, TJ_SEMANTIC, TJ_NPROGRAMS };
+
+typedef struct {
+    char     magic[8];      /* TJ_MAGIC */
+    uint32_t program;       /* TJ_TARJUMAN... */
+    uint32_t nargs;
+    uint32_t args_len;
+    uint32_t pad;
+    uint64_t source_len;
+} TjRequest;
+
+/* 1 if dir is a directory of this user's that no one else can enter, 0
+   if there is none, else -1 */
+static inline int tj_private_dir(const char *dir) {
+    struct stat st;
+    if (lstat(dir, &st) != 0) return errno == ENOENT ? 0 : -1;
+    return S_ISDIR(st.st_mode) && st.st_uid == geteuid() && (st.st_mode & 077) == 0 ? 1 : -1;
+}
+
+/* Socket path: given, else $TARJUMAN_SOCKET, else tarjuman.sock in
+   $XDG_RUNTIME_DIR or, without one, in /tmp/tarjuman-UID, which create
+   makes. That directory has to be private; the client may find none, and
+   then no server. 0, after a message, if there is no usable path. */
+static inline int tj_socket_path(struct sockaddr_un *a, const char *given, int create) {
+    char dir[sizeof a->sun_path], tmp[sizeof a->sun_path];
+    const char *path = given ? given : getenv("TARJUMAN_SOCKET");
+    if (!path || !*path) {
+        const char *run = getenv("XDG_RUNTIME_DIR");
+        int n = run && *run == '/' ? snprintf(dir, sizeof dir, "%s", run)
+                                   : snprintf(dir, sizeof dir, "/tmp/tarjuman-%lu", (unsigned long)geteuid());
+        if (n < 0 || (size_t)n >= sizeof dir) {
+            fprintf(stderr, "Socket path too long.\n");
+            return 0;
+        }
+        if (create) mkdir(dir, 0700);
+        int priv = tj_private_dir(dir);
+        if (priv < 0 || (priv == 0 && create)) {
+            fprintf(stderr, "%s is not a private directory.\n", dir);
+            return 0;
+        }
+        n = snprintf(tmp, sizeof tmp, "%s/tarjuman.sock", dir);
+        path = n < 0 || (size_t)n >= sizeof tmp ? "" : tmp;
+    }
+    memset(a, 0, sizeof *a);
+    a->sun_family = AF_UNIX;
+    if (!*path || strlen(path) >= sizeof a->sun_path) {
+        fprintf(stderr, "Socket path too long.\n");
+        return 0;
+    }
+    strcpy(a->sun_path, path);
+    return 1;
+}
+
+/* 1 if the process at the other end of sock runs as this user */
+static inline int tj_peer_is_me(int sock) {
+#ifdef SO_PEERCRED
+    struct ucred cr;
+    socklen_t n = sizeof cr;
+    return getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cr, &n) == 0 && cr.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(sock, &uid, &gid) == 0 && uid == geteuid();
+#endif
+}
+
+/* All n bytes, or 0 */
+static inline int tj_write(int fd, const void *p, size_t n) {
+    const char *c = p;
+    while (n) {
+        ssize_t w = write(fd, c, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return 0;
+        c += w;
+        n -= (size_t)w;
+    }
+    return 1;
+}
+
+static inline int tj_read(int fd, void *p, size_t n) {
+    char *c = p;
+    while (n) {
+        ssize_t r = read(fd, c, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+        c += r;
+        n -= (size_t)r;
+    }
+    return 1;
+}
+
+/* Send n bytes at p with the descriptors attached */
+static inline int tj_send_fds(int sock, const void *p, size_t n, const int *fds, int nfds) {
+    union { struct cmsghdr h; char buf[CMSG_SPACE(TJ_NFDS * sizeof(int))]; } ctl;
+    struct iovec iv = { (void *)p, n };
+    struct msghdr m;
+    memset(&m, 0, sizeof m);
+    memset(&ctl, 0, sizeof ctl);
+    m.msg_iov = &iv;
+    m.msg_iovlen = 1;
+    m.msg_control = ctl.buf;
+    m.msg_controllen = CMSG_SPACE((size_t)nfds * sizeof(int));
+    struct cmsghdr *c = CMSG_FIRSTHDR(&m);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN((size_t)nfds * sizeof(int));
+    memcpy(CMSG_DATA(c), fds, (size_t)nfds * sizeof(int));
+    ssize_t w;
+    while ((w = sendmsg(sock, &m, 0)) < 0 && errno == EINTR) {}
+    if (w <= 0) return 0;
+    return tj_write(sock, (const char *)p + w, n - (size_t)w);
+}
+
+/* Receive n bytes into p and the nfds descriptors sent with them. 0
+   unless all arrived; descriptors received are closed then. */
+static inline int tj_recv_fds(int sock, void *p, size_t n, int *fds, int nfds) {
+    union { struct cmsghdr h; char buf[CMSG_SPACE(TJ_NFDS * sizeof(int))]; } ctl;
+    struct iovec iv = { p, n };
+    struct msghdr m;
+    memset(&m, 0, sizeof m);
+    m.msg_iov = &iv;
+    m.msg_iovlen = 1;
+    m.msg_control = ctl.buf;
+    m.msg_controllen = sizeof ctl.buf;
+    for (int i = 0; i < nfds; i++) fds[i] = -1;
+    ssize_t r;
+    while ((r = recvmsg(sock, &m, 0)) < 0 && errno == EINTR) {}
+    int got = 0;
+    for (struct cmsghdr *c = r > 0 ? CMSG_FIRSTHDR(&m) : NULL; c; c = CMSG_NXTHDR(&m, c))
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            int k = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            for (int i = 0; i < k; i++) {
+                int fd;
+                memcpy(&fd, CMSG_DATA(c) + (size_t)i * sizeof fd, sizeof fd);
+                if (got < nfds) fds[got++] = fd;
+                else close(fd);
+            }
+        }
+    if (r > 0 && got == nfds && !(m.msg_flags & MSG_CTRUNC) &&
+        tj_read(sock, (char *)p + r, n - (size_t)r))
+        return 1;
+    for (int i = 0; i < got; i++) { close(fds[i]); fds[i] = -1; }
+    return 0;
+}
+
+#endif /* TJSERVE_H */
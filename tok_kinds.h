@@ -0,0 +1,58 @@
+#ifndef TOK_KINDS_H
+#define TOK_KINDS_H
+
+/* Token kinds shared by the lexer and both analysers, and the analysers'
+   Tok. The fixed-spelling tokens come first, in lex_tokens.def order, so
+   the lexer DFA's accept index is the kind itself. tok_kind_name[] gives
+   the token column of tokens.txt. */
+
+#include <stdint.h>
+#include <string.h>
+
+/* kinds the DFA does not spell out: keywords and the open-ended tokens */
+#define TOK_WORD_KINDS(X) \
+    X(IDENTIFIER) X(INT_CONST) X(CHAR_CONST) X(STRING_CONST) \
+    X(VOID) X(CHAR) X(INT) X(IF) X(ELSE) X(WHILE) X(FOR) X(MAIN)
+
+typedef enum {
+    TK_EOF,                 /* past the last token; never written */
+#define LEX_TOKEN(name, text) TK_##name,
+#include "lex_tokens.def"
+#undef LEX_TOKEN
+#define TK_WORD(name) TK_##name,
+    TOK_WORD_KINDS(TK_WORD)
+#undef TK_WORD
+    TK_UNKNOWN,             /* a tokens.txt kind this build does not know */
+    TK_NKINDS
+} TokKind;
+
+static const char *const tok_kind_name[TK_NKINDS] = {
+    "EOF",
+#define LEX_TOKEN(name, text) #name,
+#include "lex_tokens.def"
+#undef LEX_TOKEN
+#define TK_WORD(name) #name,
+    TOK_WORD_KINDS(TK_WORD)
+#undef TK_WORD
+    "?",
+};
+
+/* A token as the analysers hold it */
+typedef struct {
+    const char *lexeme;     /* C string */
+    int line;
+    int id;                 /* IDENTIFIER: name id, else -1 */
+    TokKind kind;
+    int value;              /* INT_CONST: its value, INT_MAX if out of range */
+    int out_of_range;       /* INT_CONST above INT_MAX */
+    size_t off;             /* source offset, quotes included; SIZE_MAX if unknown */
+} Tok;
+
+/* Kind of a tokens.txt token column */
+static inline TokKind tok_kind_of(const char *name) {
+    for (int k = 0; k < TK_UNKNOWN; k++)
+        if (tok_kind_name[k][0] == name[0] && strcmp(tok_kind_name[k], name) == 0) return (TokKind)k;
+    return TK_UNKNOWN;
+}
+
+#endif /* TOK_KINDS_H */
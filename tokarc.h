@@ -0,0 +1,197 @@
+#ifndef TOKARC_H
+#define TOKARC_H
+
+/* tokens.tka: a compact columnar token archive for very large inputs,
+   written by the lexer with --archive in place of tokens.bin.
+
+       header      TokArcHeader
+       blocks      per block of up to block_tokens tokens, three columns:
+                     kinds   one byte per token (TokKind)
+                     ids     lexeme ids, LEB128 varints
+                     lines   line deltas from the previous token (the
+                             first from first_line), zigzag varints
+       index       nblocks TokArcBlock
+       dict        nlex + 1 uint64_t offsets into the pool
+       pool        the distinct lexemes, NUL-terminated, in id order
+       kinds       the kind names, NUL-terminated, in TokKind order
+
+   Each lexeme is stored once; a token carries its id. Identifiers are
+   lexemes too, so an IDENTIFIER's id serves as its name id. Blocks hold
+   a fixed number of tokens, so token i lives in block i / block_tokens,
+   and any block decodes on its own through the index. Like tokens.bin,
+   the file is a build intermediate in the writer's byte order. */
+
+#include <limits.h>
+
+#include "tokfile.h"
+
+#define TOKARC_MAGIC   "TOKARC\r\n"
+#define TOKARC_VERSION 1
+#define TOKARC_BLOCK   65536        /* tokens per block */
+
+typedef struct {
+    char     magic[8];      /* TOKARC_MAGIC */
+    uint32_t version;       /* TOKARC_VERSION */
+    uint32_t byte_order;    /* TOKFILE_BYTE_ORDER as written */
+    uint32_t block_tokens;  /* tokens in every block but the last */
+    uint32_t nkinds;
+    uint64_t ntok;
+    uint64_t nblocks;
+    uint64_t nlex;          /* distinct lexemes */
+    uint64_t index;         /* file offsets of the sections */
+    uint64_t dict;
+    uint64_t pool, pool_len;
+    uint64_t kinds, kinds_len;
+} TokArcHeader;
+
+typedef struct {
+    uint64_t off;           /* file offset of the block's kinds */
+    uint32_t count;         /* tokens in the block */
+    uint32_t ids_len;       /* bytes of id varints, after the kinds */
+    uint32_t lines_len;     /* bytes of line varints, after the ids */
+    int32_t  first_line;
+} TokArcBlock;
+
+/* One decoded token */
+typedef struct {
+    uint32_t id;            /* lexeme id */
+    int line;
+    TokKind kind;
+} TokArcToken;
+
+typedef struct {
+    const TokArcHeader *h;
+    const TokArcBlock *block;
+    const uint64_t *dict;
+    const char *base;       /* the mapping */
+    const char *pool;
+    size_t size;
+} TokArchive;
+
+/* Map and check an archive's header, index and dictionary. 1 on success;
+   0 if it does not exist; -1 (after a message) if it is unusable. Block
+   contents are checked as they are decoded. */
+static inline int tokarc_open(TokArchive *a, const char *path) {
+    memset(a, 0, sizeof *a);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    void *p = NULL;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(TokArcHeader))
+        p = tokfile_map(fd, (size_t)st.st_size);
+    close(fd);
+    if (!p) { fprintf(stderr, "%s: not a token archive\n", path); return -1; }
+
+    const TokArcHeader *h = p;
+    const char *base = p;
+    uint64_t size = (uint64_t)st.st_size;
+    const char *why = NULL;
+    if (memcmp(h->magic, TOKARC_MAGIC, 8) != 0) why = "not a token archive";
+    else if (h->byte_order != TOKFILE_BYTE_ORDER) why = "written with another byte order";
+    else if (h->version != TOKARC_VERSION) why = "unsupported token archive version";
+    else if (h->block_tokens == 0 || h->index % 8 || h->dict % 8 ||
+             h->nblocks != (h->ntok + h->block_tokens - 1) / h->block_tokens ||
+             h->index > size || h->nblocks > (size - h->index) / sizeof(TokArcBlock) ||
+             h->dict > size || h->nlex >= (size - h->dict) / 8 ||
+             h->pool > size || h->pool_len > size - h->pool ||
+             h->kinds > size || h->kinds_len > size - h->kinds ||
+             (h->pool_len && base[h->pool + h->pool_len - 1] != 0))
+        why = "corrupt token archive";
+    else if (h->nkinds != TK_NKINDS) why = "token kinds differ from this build";
+    if (!why) {
+        const char *k = base + h->kinds, *e = k + h->kinds_len;
+        for (int i = 0; i < TK_NKINDS && !why; i++) {
+            size_t n = strlen(tok_kind_name[i]) + 1;
+            if ((size_t)(e - k) < n || memcmp(k, tok_kind_name[i], n) != 0) why = "token kinds differ from this build";
+            k += n;
+        }
+        const uint64_t *dict = (const uint64_t *)(base + h->dict);
+        for (uint64_t i = 0; i < h->nlex && !why; i++)
+            if (dict[i] >= dict[i + 1] || dict[i + 1] > h->pool_len) why = "corrupt token archive";
+        const TokArcBlock *b = (const TokArcBlock *)(base + h->index);
+        for (uint64_t i = 0; i < h->nblocks && !why; i++) {
+            uint64_t want = i + 1 < h->nblocks ? h->block_tokens : h->ntok - i * h->block_tokens;
+            if (b[i].count != want || b[i].off > size ||
+                (uint64_t)b[i].count + b[i].ids_len + b[i].lines_len > size - b[i].off)
+                why = "corrupt token archive";
+        }
+    }
+    if (why) {
+        fprintf(stderr, "%s: %s\n", path, why);
+        tokfile_unmap(p, (size_t)st.st_size);
+        return -1;
+    }
+    a->h = h;
+    a->base = base;
+    a->block = (const TokArcBlock *)(base + h->index);
+    a->dict = (const uint64_t *)(base + h->dict);
+    a->pool = base + h->pool;
+    a->size = (size_t)st.st_size;
+    return 1;
+}
+
+/* Lexeme id as a C string */
+static inline const char *tokarc_lexeme(const TokArchive *a, uint32_t id) {
+    return a->pool + a->dict[id];
+}
+
+/* Varint at *p, not past e; 0 if it runs over */
+static int tokarc_varint(const unsigned char **p, const unsigned char *e, uint64_t *v) {
+    uint64_t x = 0;
+    for (int shift = 0; *p < e && shift < 64; shift += 7) {
+        unsigned char c = *(*p)++;
+        x |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) { *v = x; return 1; }
+    }
+    return 0;
+}
+
+/* Decode block b into out[0, a->block[b].count). 1 on success, 0 if the
+   block is corrupt. */
+static inline int tokarc_block(const TokArchive *a, uint64_t b, TokArcToken *out) {
+    const TokArcBlock *blk = &a->block[b];
+    const unsigned char *kinds = (const unsigned char *)a->base + blk->off;
+    const unsigned char *ids = kinds + blk->count, *ids_end = ids + blk->ids_len;
+    const unsigned char *lines = ids_end, *lines_end = lines + blk->lines_len;
+    int64_t line = blk->first_line;
+    for (uint32_t i = 0; i < blk->count; i++) {
+        uint64_t id, d;
+        if (kinds[i] >= TK_UNKNOWN || !tokarc_varint(&ids, ids_end, &id) || id >= a->h->nlex ||
+            !tokarc_varint(&lines, lines_end, &d))
+            return 0;
+        line += (int64_t)(d >> 1) ^ -(int64_t)(d & 1);
+        if (line < INT_MIN || line > INT_MAX) return 0;
+        out[i].kind = (TokKind)kinds[i];
+        out[i].id = (uint32_t)id;
+        out[i].line = (int)line;
+    }
+    return 1;
+}
+
+/* Decode tokens [first, first + n) into out, touching only the blocks
+   that hold them. 1 on success, 0 if out of range or corrupt. */
+static inline int tokarc_read(const TokArchive *a, uint64_t first, size_t n, TokArcToken *out) {
+    if (first > a->h->ntok || n > a->h->ntok - first) return 0;
+    TokArcToken *tmp = NULL;
+    int ok = 1;
+    while (n && ok) {
+        uint64_t b = first / a->h->block_tokens, skip = first % a->h->block_tokens;
+        uint32_t count = a->block[b].count;
+        size_t take = count - skip < n ? (size_t)(count - skip) : n;
+        if (skip == 0 && take == count) ok = tokarc_block(a, b, out);
+        else {
+            if (!tmp && !(tmp = malloc(a->h->block_tokens * sizeof *tmp))) return 0;
+            if ((ok = tokarc_block(a, b, tmp))) memcpy(out, tmp + skip, take * sizeof *out);
+        }
+        out += take; first += take; n -= take;
+    }
+    free(tmp);
+    return ok;
+}
+
+static inline void tokarc_close(TokArchive *a) {
+    if (a->h) tokfile_unmap((void *)a->h, a->size);
+    memset(a, 0, sizeof *a);
+}
+
+#endif /* TOKARC_H */
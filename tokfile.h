@@ -0,0 +1,182 @@
+#ifndef TOKFILE_H
+#define TOKFILE_H
+
+/* tokens.bin: the lexer's output in a form the analysers map and use in
+   place, with no text parsing.
+
+       header      TokFileHeader
+       records     ntok fixed-width TokRecord, in token order
+       kinds       nkinds uint64_t pool offsets of the kind names
+       pool        NUL-terminated strings: lexemes (a string constant's
+                   decoded bytes follow its lexeme), kind names
+
+   Numbers are in the writer's byte order (byte_order tells); the file is
+   a build intermediate, not an interchange format. A record's kind is the
+   TokKind itself; readers reject any other version, and a file whose kind
+   names are not this build's. tokens.txt stays available as a text export. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "tok_kinds.h"
+
+#define TOKFILE_MAGIC      "TOKBIN\r\n"
+#define TOKFILE_VERSION    2
+#define TOKFILE_BYTE_ORDER 0x01020304u
+
+/* TokRecord.flags */
+#define TOK_QUOTED       1   /* constant: off/len sit inside the quotes */
+#define TOK_OUT_OF_RANGE 2   /* INT_CONST above INT_MAX; value is INT_MAX */
+
+typedef struct {
+    char     magic[8];      /* TOKFILE_MAGIC */
+    uint32_t version;       /* TOKFILE_VERSION */
+    uint32_t byte_order;    /* TOKFILE_BYTE_ORDER as written */
+    uint32_t record_size;   /* sizeof(TokRecord) */
+    uint32_t nkinds;
+    uint64_t ntok;
+    uint64_t nnames;        /* identifier ids run 0..nnames-1 */
+    uint64_t records;       /* file offsets of the sections */
+    uint64_t kinds;
+    uint64_t pool, pool_len;
+} TokFileHeader;
+
+typedef struct {
+    uint16_t kind;          /* TokKind */
+    uint16_t flags;         /* TOK_* */
+    int32_t  line;
+    int32_t  value;         /* INT_CONST: value; CHAR_CONST: its decoded byte;
+                               STRING_CONST: decoded length; IDENTIFIER: name id */
+    uint32_t len;           /* lexeme length */
+    uint64_t off;           /* lexeme offset in the source */
+    uint64_t text;          /* pool offset of the lexeme */
+} TokRecord;
+
+typedef struct {
+    const TokFileHeader *h;
+    const TokRecord *rec;
+    const uint64_t *kinds;
+    const char *pool;
+    size_t size;            /* of the mapping */
+} TokFile;
+
+/* The whole file, mapped where mmap exists, else read into memory */
+static void *tokfile_map(int fd, size_t size) {
+#ifndef _WIN32
+    void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) return NULL;
+    madvise(p, size, MADV_SEQUENTIAL);
+    return p;
+#else
+    char *p = malloc(size);
+    size_t got = 0;
+    long n;
+    while (p && got < size && (n = (long)read(fd, p + got, (unsigned)(size - got))) > 0) got += (size_t)n;
+    if (p && got < size) { free(p); p = NULL; }
+    return p;
+#endif
+}
+
+static void tokfile_unmap(void *p, size_t size) {
+#ifndef _WIN32
+    munmap(p, size);
+#else
+    (void)size;
+    free(p);
+#endif
+}
+
+/* Map and check a token file. 1 on success; 0 if it does not exist;
+   -1 (after a message) if it is unreadable or not a valid file for this build. */
+static inline int tokfile_open(TokFile *tf, const char *path) {
+    memset(tf, 0, sizeof *tf);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    void *p = NULL;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(TokFileHeader))
+        p = tokfile_map(fd, (size_t)st.st_size);
+    close(fd);
+    if (!p) { fprintf(stderr, "%s: not a token file\n", path); return -1; }
+
+    const TokFileHeader *h = p;
+    uint64_t size = (uint64_t)st.st_size;
+    const char *why = NULL;
+    if (memcmp(h->magic, TOKFILE_MAGIC, 8) != 0) why = "not a token file";
+    else if (h->byte_order != TOKFILE_BYTE_ORDER) why = "written with another byte order";
+    else if (h->version != TOKFILE_VERSION) why = "unsupported token file version";
+    else if (h->record_size != sizeof(TokRecord) ||
+             h->records % 8 || h->kinds % 8 ||
+             h->records > size || h->ntok > (size - h->records) / sizeof(TokRecord) ||
+             h->kinds > size || h->nkinds > (size - h->kinds) / 8 ||
+             h->pool > size || h->pool_len > size - h->pool ||
+             h->pool_len == 0 || ((const char *)p)[h->pool + h->pool_len - 1] != 0)
+        why = "corrupt token file";
+    if (!why) {
+        const uint64_t *kinds = (const uint64_t *)((const char *)p + h->kinds);
+        const char *pool = (const char *)p + h->pool;
+        if (h->nkinds != TK_NKINDS) why = "token kinds differ from this build";
+        for (uint32_t k = 0; k < h->nkinds && !why; k++) {
+            if (kinds[k] >= h->pool_len) why = "corrupt token file";
+            else if (strcmp(pool + kinds[k], tok_kind_name[k]) != 0) why = "token kinds differ from this build";
+        }
+        const TokRecord *r = (const TokRecord *)((const char *)p + h->records);
+        for (uint64_t i = 0; i < h->ntok && !why; i++) {
+            /* the lexeme, and a string's decoded bytes, end inside the pool */
+            uint64_t end = r[i].text + r[i].len;
+            if (r[i].kind == TK_STRING_CONST) end += 1 + (uint32_t)r[i].value;
+            if (r[i].kind >= TK_UNKNOWN || r[i].text >= h->pool_len || r[i].len >= h->pool_len - r[i].text ||
+                end >= h->pool_len ||
+                (r[i].kind == TK_IDENTIFIER && (r[i].value < 0 || (uint64_t)r[i].value >= h->nnames)))
+                why = "corrupt token file";
+        }
+    }
+    if (why) {
+        fprintf(stderr, "%s: %s\n", path, why);
+        tokfile_unmap(p, (size_t)st.st_size);
+        return -1;
+    }
+    tf->h = h;
+    tf->rec = (const TokRecord *)((const char *)p + h->records);
+    tf->kinds = (const uint64_t *)((const char *)p + h->kinds);
+    tf->pool = (const char *)p + h->pool;
+    tf->size = (size_t)st.st_size;
+    return 1;
+}
+
+static inline TokKind tokfile_kind(const TokRecord *r) {
+    return (TokKind)r->kind;
+}
+
+/* Lexeme as a C string (r->len bytes, unless it holds a NUL) */
+static inline const char *tokfile_text(const TokFile *tf, const TokRecord *r) {
+    return tf->pool + r->text;
+}
+
+/* IDENTIFIER: the name id, else -1 */
+static inline int tokfile_id(const TokRecord *r) {
+    return r->kind == TK_IDENTIFIER ? r->value : -1;
+}
+
+/* STRING_CONST: the decoded bytes (r->value of them, NUL-terminated) */
+static inline const char *tokfile_string(const TokFile *tf, const TokRecord *r) {
+    return tf->pool + r->text + r->len + 1;
+}
+
+static inline void tokfile_close(TokFile *tf) {
+    if (tf->h) tokfile_unmap((void *)tf->h, tf->size);
+    memset(tf, 0, sizeof *tf);
+}
+
+#endif /* TOKFILE_H */
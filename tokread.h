@@ -0,0 +1,262 @@
+#ifndef TOKREAD_H
+#define TOKREAD_H
+
+/* Token input shared by the analysers: loading tokens.bin, tokens.tka or
+   tokens.txt, or taking the driver's tokens, and the cursor the grammar
+   reads them through. Each analyser includes this once, so the state
+   below is that analyser's own.
+
+   Loaded tokens go to toks, with lexemes pointing into the mapped
+   tokens.bin or tokens.tka or the read tokens.txt. Streamed tokens stay
+   in the driver's ring. Either way tokens are read in place, never
+   copied; past the end the lookahead is an EOF token on the last
+   token's line. tokens.tka and tokens.txt record no source offsets.
+
+   The including file defines program() and print_symbol_table(), which
+   analyse() runs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include "intern.h"
+#include "tokfile.h"
+#include "tokarc.h"
+#include "toktext.h"
+#include "store.h"
+#include "tokring.h"
+
+static Store toks = { .elem = sizeof(Tok) };
+static size_t ntok = 0;
+static size_t pos  = 0;
+static TokRing *ring;
+static TokFile tokfile;
+static TokArchive tokarc;
+static TokText toktext;
+static size_t tok_names;                /* name ids the loaded tokens use */
+
+/* --stats counts lookaheads only in a build with -DTOK_STATS, keeping the
+   counter out of LA() otherwise */
+#ifdef TOK_STATS
+static unsigned long long tok_reads;
+#define TOK_COUNT_READ() (tok_reads++)
+#else
+#define TOK_COUNT_READ() ((void)0)
+#endif
+
+static Tok eof_tok = {"", 0, -1, TK_EOF, 0, 0, SIZE_MAX};   /* line 0 until first needed */
+
+static void program(void);
+static void print_symbol_table(void);
+
+/* ---------- cursor ---------- */
+
+/* Token i, or NULL past the end */
+static inline const Tok *tok_get(size_t i) {
+    if (ring) return tokring_get(ring, i);
+    return i < ntok ? (const Tok *)store_at(&toks, i) : NULL;
+}
+
+/* The EOF token. Once the cursor is at the end the last token is just
+   behind it, and still readable from a ring. */
+static const Tok *tok_eof(void) {
+    if (!eof_tok.line) {
+        const Tok *t = pos > 0 ? tok_get(pos - 1) : NULL;
+        eof_tok.line = t ? t->line : 1;
+        eof_tok.off = t ? t->off : SIZE_MAX;
+    }
+    return &eof_tok;
+}
+
+static inline const Tok *LA(void) {
+    TOK_COUNT_READ();
+    const Tok *t = tok_get(pos);
+    return t ? t : tok_eof();
+}
+
+static inline TokKind peek(void) {
+    return LA()->kind;
+}
+
+/* Kind of the token after the lookahead */
+static inline TokKind peek2(void) {
+    const Tok *t = tok_get(pos + 1);
+    return t ? t->kind : TK_EOF;
+}
+
+static inline const Tok *consume(void) {
+    const Tok *t = LA();
+    if (t != &eof_tok) pos++;
+    return t;
+}
+
+static inline int match(TokKind tk, const Tok **out) {
+    if (peek() != tk) return 0;
+    const Tok *a = consume();
+    if (out) *out = a;
+    return 1;
+}
+
+/* Error recovery: skip the rest of the tokens on line */
+static inline void skip_line_tokens(int line) {
+    const Tok *t;
+    while ((t = tok_get(pos)) && t->line == line) pos++;
+}
+
+/* ---------- loaders ---------- */
+
+/* An INT_CONST's value from its lexeme [p, e), as the lexer gives it in
+   tokens.bin and the ring; the archive and the text export have none */
+static inline void tok_int_value(Tok *t, const char *p, const char *e) {
+    t->out_of_range = !toktext_int(p, e, &t->value);
+    if (t->out_of_range) t->value = INT_MAX;
+}
+
+/* Tokens of a mapped tokens.bin, or the lexer's in the driver; name ids
+   are the lexer's */
+static inline void take_tokens(const TokFile *tf) {
+    for (uint64_t i = 0; i < tf->h->ntok; i++) {
+        const TokRecord *r = &tf->rec[i];
+        Tok *t = store_push(&toks);
+        t->kind = tokfile_kind(r);
+        t->lexeme = tokfile_text(tf, r);
+        t->line = r->line;
+        t->id = tokfile_id(r);
+        t->off = r->off - (r->flags & TOK_QUOTED ? 1 : 0);
+        if (t->kind == TK_INT_CONST) {
+            t->value = r->value;
+            t->out_of_range = (r->flags & TOK_OUT_OF_RANGE) != 0;
+        }
+        ntok++;
+    }
+    tok_names = (size_t)tf->h->nnames;
+}
+
+/* Binary token file: 1 when loaded, 0 if there is none, -1 if unusable.
+   The file stays mapped for the lexemes. */
+static inline int load_token_file(const char *fname) {
+    int rc = tokfile_open(&tokfile, fname);
+    if (rc <= 0) return rc;
+    take_tokens(&tokfile);
+    return 1;
+}
+
+/* Token archive: 1 when loaded, 0 if there is none, -1 if unusable.
+   Tokens decode a block's worth at a time; a lexeme's dictionary id is
+   the name id. */
+static inline int load_token_archive(const char *fname) {
+    int rc = tokarc_open(&tokarc, fname);
+    if (rc <= 0) return rc;
+    size_t batch = tokarc.h->block_tokens;
+    TokArcToken *blk = malloc(batch * sizeof *blk);
+    if (!blk) { fprintf(stderr, "Out of memory\n"); return -1; }
+    for (uint64_t first = 0; first < tokarc.h->ntok; first += batch) {
+        size_t n = tokarc.h->ntok - first < batch ? (size_t)(tokarc.h->ntok - first) : batch;
+        if (!tokarc_read(&tokarc, first, n, blk)) {
+            fprintf(stderr, "%s: corrupt token archive\n", fname);
+            free(blk);
+            return -1;
+        }
+        for (size_t i = 0; i < n; i++) {
+            Tok *t = store_push(&toks);
+            t->kind = blk[i].kind;
+            t->lexeme = tokarc_lexeme(&tokarc, blk[i].id);
+            t->line = blk[i].line;
+            t->id = blk[i].kind == TK_IDENTIFIER ? (int)blk[i].id : -1;
+            t->off = SIZE_MAX;
+            if (t->kind == TK_INT_CONST) tok_int_value(t, t->lexeme, t->lexeme + strlen(t->lexeme));
+            ntok++;
+        }
+    }
+    free(blk);
+    tok_names = (size_t)tokarc.h->nlex;
+    return 1;
+}
+
+/* tokens.txt through the shared reader: 1 when loaded, else 0. The text
+   has no name ids; with names given, identifiers are interned there. */
+static inline int load_token_text(const char *fname, InternTable *names) {
+    if (toktext_open(&toktext, fname) <= 0) return 0;
+    TokTextRow row;
+    while (toktext_next(&toktext, &row)) {
+        Tok *t = store_push(&toks);
+        t->kind = tok_kind_of(row.kind);
+        t->lexeme = row.lexeme;
+        t->line = row.line;
+        t->id = names && t->kind == TK_IDENTIFIER ? (int)intern(names, row.lexeme, row.len) : -1;
+        t->off = SIZE_MAX;
+        if (t->kind == TK_INT_CONST) tok_int_value(t, row.lexeme, row.lexeme + row.len);
+        ntok++;
+    }
+    tok_names = names ? names->count : 0;
+    return 1;
+}
+
+/* tokens.bin when the lexer wrote one, then tokens.tka, else the text
+   export: 1 when loaded, 0 if there is none, -1 if unusable */
+static inline int load_tokens(InternTable *names) {
+    int rc = load_token_file("tokens.bin");
+    if (rc == 0) rc = load_token_archive("tokens.tka");
+    if (rc == 0) rc = load_token_text("tokens.txt", names);
+    return rc;
+}
+
+/* ---------- runs ---------- */
+
+/* Forget an earlier run's tokens, such as the compile server's warm-up
+   run that its children start from. Storage is kept for the next. */
+static inline void tokens_reset(void) {
+    store_clear(&toks);
+    ntok = pos = 0;
+    eof_tok.line = 0;
+    tok_names = 0;
+#ifdef TOK_STATS
+    tok_reads = 0;
+#endif
+    ring = NULL;
+}
+
+/* Options shared by the entry points; the symbol table is written by
+   default only when the tokens come from a file */
+static inline void read_options(int argc, char **argv, Store *symtab, int *stats, int *symbols) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) *stats = 1;
+        else if (strcmp(argv[i], "--hugepages") == 0) toks.huge = symtab->huge = 1;
+        else if (strcmp(argv[i], "--symbols") == 0) *symbols = 1;
+    }
+}
+
+/* The by-value Tok the cursor replaced, for --stats */
+typedef struct {
+    char token[32];
+    char lexeme[256];
+    int line;
+} OldTok;
+
+/* --stats: time, and with TOK_STATS lookahead traffic. The byte figures
+   are estimates, lookaheads times the size handed out: a pointer now,
+   where each would have copied a whole OldTok. */
+static void print_stats(FILE *err, const char *verb, double secs) {
+#ifdef TOK_STATS
+    double per = ntok ? (double)tok_reads / ntok : 0;
+    fprintf(err, "%s %zu tokens in %.3f s, %.2f lookaheads per token\n", verb, ntok, secs, per);
+    fprintf(err, "Estimated token bytes moved per token: %.1f (by-value %zu-byte Tok: %.1f)\n",
+            per * sizeof(const Tok *), sizeof(OldTok), per * sizeof(OldTok));
+#else
+    fprintf(err, "%s %zu tokens in %.3f s (lookahead counts need -DTOK_STATS)\n", verb, ntok, secs);
+#endif
+}
+
+/* Run program() over the tokens, reading a ring to the end */
+static inline void analyse(FILE *err, const char *verb, int stats, int symbols) {
+    clock_t start = clock();
+    program();
+    if (ring) ntok = tokring_drain(ring);
+    if (stats) print_stats(err, verb, (double)(clock() - start) / CLOCKS_PER_SEC);
+    /* streamed: no symbol table when lexing failed, as none would be in turn */
+    if (symbols && !(ring && ring->failed)) print_symbol_table();
+}
+
+#endif /* TOKREAD_H */
@@ -0,0 +1,169 @@
+#ifndef TOKRING_H
+#define TOKRING_H
+
+/* The ring through which the tarjuman driver's lexer thread feeds an
+   analyser running alongside it.
+
+   The ring is single-producer, single-consumer, over TOKRING_SLOTS
+   batches of tokens. The producer fills a batch and publishes it by
+   advancing head; the consumer reads published batches in place and
+   hands them back by advancing tail. Each index has one writer and only
+   grows, so no lock is needed: the store-release of an index and the
+   load-acquire on the other side order the batch contents with it. A
+   full ring stalls the producer and an empty one the consumer, so the
+   ring never holds more than TOKRING_SLOTS batches, however long the
+   input.
+
+   Every batch but the last holds TOKRING_BATCH tokens, so token i is in
+   batch i / TOKRING_BATCH. The consumer keeps TOKRING_KEEP batches
+   behind the one it last asked for, so tokens just behind the parser
+   stay readable. An identifier's lexeme is not copied into the batch:
+   the producer passes a copy that outlives the ring, as symbol tables
+   keep it. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#include "tok_kinds.h"
+
+#define TOKRING_BATCH_LOG 12
+#define TOKRING_BATCH     ((size_t)1 << TOKRING_BATCH_LOG)    /* tokens per batch */
+#define TOKRING_SLOTS     8
+#define TOKRING_KEEP      2
+
+typedef struct {
+    Tok tok[TOKRING_BATCH];
+    size_t at[TOKRING_BATCH];   /* while filling: lexeme offset in text, or SIZE_MAX if set */
+    size_t n;
+    int last;                   /* the producer's final batch */
+    char *text;                 /* the batch's lexemes, NUL-terminated */
+    size_t text_len, text_cap;
+} TokBatch;
+
+typedef struct {
+    TokBatch slot[TOKRING_SLOTS];
+    atomic_size_t head;         /* batches published */
+    char pad0[64];
+    atomic_size_t tail;         /* batches handed back */
+    char pad1[64];
+    size_t put;                 /* producer: batches published */
+    int filling;                /* producer: slot put % TOKRING_SLOTS is in use */
+    int failed;                 /* set with the last batch: the tokens are not to be used */
+    char pad2[64];
+    size_t lim;                 /* consumer: tokens below this are readable */
+    size_t kept;                /* consumer: batches handed back */
+    size_t end;                 /* consumer: token count, once the last batch is seen */
+} TokRing;
+
+static inline TokRing *tokring_new(void) {
+    TokRing *r = calloc(1, sizeof *r);
+    if (!r) { fprintf(stderr, "Out of memory\n"); exit(1); }
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->end = SIZE_MAX;
+    return r;
+}
+
+static inline void tokring_free(TokRing *r) {
+    for (int i = 0; i < TOKRING_SLOTS; i++) free(r->slot[i].text);
+    free(r);
+}
+
+/* ---------- producer ---------- */
+
+/* Batch to fill, once the consumer has handed its slot back */
+static inline TokBatch *tokring_batch(TokRing *r) {
+    TokBatch *b = &r->slot[r->put % TOKRING_SLOTS];
+    if (r->filling) return b;
+    while (r->put - atomic_load_explicit(&r->tail, memory_order_acquire) >= TOKRING_SLOTS) sched_yield();
+    b->n = 0;
+    b->text_len = 0;
+    b->last = 0;
+    r->filling = 1;
+    return b;
+}
+
+static inline void tokring_publish(TokRing *r) {
+    TokBatch *b = &r->slot[r->put % TOKRING_SLOTS];
+    for (size_t i = 0; i < b->n; i++)
+        if (b->at[i] != SIZE_MAX) b->tok[i].lexeme = b->text + b->at[i];
+    r->filling = 0;
+    atomic_store_explicit(&r->head, ++r->put, memory_order_release);
+}
+
+/* Append tok. Its lexeme is tok->lexeme if set, which must outlive the
+   ring, else a copy of text[0, len). */
+static inline void tokring_put(TokRing *r, const Tok *tok, const char *text, size_t len) {
+    TokBatch *b = tokring_batch(r);
+    Tok *t = &b->tok[b->n];
+    *t = *tok;
+    if (tok->lexeme) {
+        b->at[b->n] = SIZE_MAX;
+    } else {
+        if (b->text_cap - b->text_len < len + 1) {
+            size_t cap = b->text_cap ? b->text_cap : 1 << 16;
+            while (cap - b->text_len < len + 1) cap *= 2;
+            char *p = realloc(b->text, cap);
+            if (!p) { fprintf(stderr, "Out of memory\n"); exit(1); }
+            b->text = p;
+            b->text_cap = cap;
+        }
+        memcpy(b->text + b->text_len, text, len);
+        b->text[b->text_len + len] = 0;
+        b->at[b->n] = b->text_len;
+        b->text_len += len + 1;
+    }
+    if (++b->n == TOKRING_BATCH) tokring_publish(r);
+}
+
+/* Publish the final batch, which may be empty. failed: the producer gave
+   up, and what it sent is not to be used. */
+static inline void tokring_close(TokRing *r, int failed) {
+    r->failed = failed;
+    tokring_batch(r)->last = 1;
+    tokring_publish(r);
+}
+
+/* ---------- consumer ---------- */
+
+static const Tok *tokring_wait(TokRing *r, size_t i) {
+    size_t b = i >> TOKRING_BATCH_LOG;
+    if (i >= r->end) return NULL;
+    if (b >= TOKRING_KEEP && r->kept < b - TOKRING_KEEP) {
+        r->kept = b - TOKRING_KEEP;
+        atomic_store_explicit(&r->tail, r->kept, memory_order_release);
+    }
+    size_t head;
+    for (;;) {
+        head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (head && r->slot[(head - 1) % TOKRING_SLOTS].last)
+            r->end = ((head - 1) << TOKRING_BATCH_LOG) + r->slot[(head - 1) % TOKRING_SLOTS].n;
+        if (head > b || r->end != SIZE_MAX) break;
+        sched_yield();
+    }
+    if (i >= r->end) return NULL;
+    r->lim = (b + 1) << TOKRING_BATCH_LOG;
+    if (r->lim > r->end) r->lim = r->end;
+    return &r->slot[b % TOKRING_SLOTS].tok[i & (TOKRING_BATCH - 1)];
+}
+
+/* Token i, waiting for the producer as needed; NULL past the end. Only
+   tokens from TOKRING_KEEP batches before the latest asked for on. */
+static inline const Tok *tokring_get(TokRing *r, size_t i) {
+    if (i < r->lim) return &r->slot[(i >> TOKRING_BATCH_LOG) % TOKRING_SLOTS].tok[i & (TOKRING_BATCH - 1)];
+    return tokring_wait(r, i);
+}
+
+/* Read to the end, handing every batch back so the producer can finish.
+   Returns the token count. */
+static inline size_t tokring_drain(TokRing *r) {
+    while (tokring_get(r, r->lim)) {}
+    atomic_store_explicit(&r->tail, atomic_load_explicit(&r->head, memory_order_acquire), memory_order_release);
+    return r->end;
+}
+
+#endif /* TOKRING_H */
@@ -0,0 +1,111 @@
+#ifndef TOKTEXT_H
+#define TOKTEXT_H
+
+/* tokens.txt reader shared by the analysers. The file is read whole and
+   split in place: memchr finds each row's newline and first tab, and the
+   line number after the last tab is parsed by hand. The kind runs to the
+   first tab and the lexeme to the last, so lexemes keep their spaces and
+   tabs. Rows without a numeric line field (the header, blank or damaged
+   lines) are skipped. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct {
+    char *buf;              /* the whole file, NUL-terminated */
+    size_t len;
+    char *next;             /* start of the next row */
+} TokText;
+
+typedef struct {
+    const char *kind;       /* NUL-terminated, inside the buffer */
+    const char *lexeme;
+    size_t len;             /* of the lexeme */
+    int line;
+} TokTextRow;
+
+/* Read path whole. 1 on success; 0 if it cannot be opened; -1 (after a
+   message) if it cannot be held in memory. */
+static inline int toktext_open(TokText *tt, const char *path) {
+    memset(tt, 0, sizeof *tt);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    size_t cap = 1 << 16;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) cap = (size_t)st.st_size + 1;
+    char *buf = malloc(cap + 1);
+    size_t len = 0;
+    long n;
+    while (buf && (n = (long)read(fd, buf + len, (unsigned)(cap - len < (1u << 30) ? cap - len : (1u << 30)))) > 0) {
+        len += (size_t)n;
+        if (len == cap) {               /* grew since fstat, or not a regular file */
+            char *b = realloc(buf, 2 * cap + 1);
+            if (!b) free(buf);
+            buf = b;
+            cap *= 2;
+        }
+    }
+    close(fd);
+    if (!buf) { fprintf(stderr, "Out of memory\n"); return -1; }
+    buf[len] = 0;
+    tt->buf = tt->next = buf;
+    tt->len = len;
+    return 1;
+}
+
+/* Decimal [p, e) into *v; 0 unless it is all digits and fits an int */
+static int toktext_int(const char *p, const char *e, int *v) {
+    if (p == e) return 0;
+    long long x = 0;
+    for (; p < e; p++) {
+        if (*p < '0' || *p > '9') return 0;
+        x = x * 10 + (*p - '0');
+        if (x > INT_MAX) return 0;
+    }
+    *v = (int)x;
+    return 1;
+}
+
+/* Next token row, its kind and lexeme NUL-terminated in place. 0 at the end. */
+static inline int toktext_next(TokText *tt, TokTextRow *row) {
+    char *end = tt->buf + tt->len;
+    while (tt->next < end) {
+        char *s = tt->next;
+        char *e = memchr(s, '\n', (size_t)(end - s));
+        tt->next = e ? e + 1 : end;
+        if (!e) e = end;
+        if (e > s && e[-1] == '\r') e--;
+
+        char *tab1 = memchr(s, '\t', (size_t)(e - s));
+        if (!tab1) continue;
+        char *num = e;
+        while (num > tab1 && num[-1] != '\t') num--;
+        if (num - 1 == tab1) continue;  /* one tab: no lexeme column */
+        if (!toktext_int(num, e, &row->line)) continue;
+
+        *tab1 = 0;
+        num[-1] = 0;
+        row->kind = s;
+        row->lexeme = tab1 + 1;
+        row->len = (size_t)(num - 1 - (tab1 + 1));
+        return 1;
+    }
+    return 0;
+}
+
+static inline void toktext_close(TokText *tt) {
+    free(tt->buf);
+    memset(tt, 0, sizeof *tt);
+}
+
+#endif /* TOKTEXT_H */